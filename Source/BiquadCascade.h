@@ -0,0 +1,221 @@
+/*
+  ==============================================================================
+
+    Каскад биквадов LowCut -> Peak -> HighCut, который считает несколько каналов
+    за одну SIMD инструкцию.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <vector>
+
+//коэффициенты одного биквада уже нормированные на a0: b0, b1, b2, a1, a2.
+//рассчитываются в double, каскад сам приводит их к своему типу сэмплов
+using BiquadCoefficients = std::array<double, 5>;
+
+/**
+ каждая дорожка SIMD регистра - отдельный канал, коэффициенты у всех каналов общие.
+ стерео укладывается в один регистр, и весь каскад считается один раз на сэмпл.
+
+ коэффициенты и состояние активных ступеней лежат подряд (структура массивов),
+ а цикл по сэмплам специализирован на число ступеней при компиляции.
+ нужная специализация выбирается один раз в setStages, а не на каждом сэмпле.
+ */
+template<typename SampleType>
+struct SIMDBiquadCascade
+{
+    using SIMDType = juce::dsp::SIMDRegister<SampleType>;
+
+    //4 ступени LowCut, Peak, 4 ступени HighCut
+    static constexpr int numSlots = 9;
+
+    static int getMaxNumChannels() { return (int)SIMDType::size(); }
+
+    void prepare(int maximumBlockSize)
+    {
+        interleaved.resize((size_t)juce::jmax(1, maximumBlockSize));
+        reset();
+    }
+
+    void reset()
+    {
+        const auto zero = SIMDType::expand(0);
+
+        std::fill(z1.begin(), z1.end(), zero);
+        std::fill(z2.begin(), z2.end(), zero);
+        std::fill(slotZ1.begin(), slotZ1.end(), zero);
+        std::fill(slotZ2.begin(), slotZ2.end(), zero);
+    }
+
+    /**
+     nullptr в слоте значит, что ступень выключена (байпас или не нужна при текущем наклоне).
+     */
+    void setStages(const std::array<const BiquadCoefficients*, numSlots>& slots)
+    {
+        //сохраняем состояние ступеней, чтобы продолжить с него, если ступень останется включенной
+        std::array<bool, numSlots> wasActive {};
+        for( int s = 0; s < numActive; ++s )
+        {
+            slotZ1[activeSlots[s]] = z1[s];
+            slotZ2[activeSlots[s]] = z2[s];
+            wasActive[activeSlots[s]] = true;
+        }
+
+        int newNumActive = 0;
+
+        for( int slot = 0; slot < numSlots; ++slot )
+        {
+            auto* c = slots[slot];
+            if( c == nullptr )
+                continue;
+
+            const auto k = newNumActive++;
+
+            //ступень только что включилась - начинаем с чистого состояния
+            z1[k] = wasActive[slot] ? slotZ1[slot] : SIMDType::expand(0);
+            z2[k] = wasActive[slot] ? slotZ2[slot] : SIMDType::expand(0);
+
+            b0[k] = SIMDType::expand((SampleType)(*c)[0]);
+            b1[k] = SIMDType::expand((SampleType)(*c)[1]);
+            b2[k] = SIMDType::expand((SampleType)(*c)[2]);
+            a1[k] = SIMDType::expand((SampleType)(*c)[3]);
+            a2[k] = SIMDType::expand((SampleType)(*c)[4]);
+
+            activeSlots[k] = slot;
+        }
+
+        numActive = newNumActive;
+        processFunction = getProcessFunction(numActive);
+    }
+
+    //наибольшее по модулю значение в состоянии активных ступеней, по нему видно, затух ли каскад
+    SampleType getMaxStateMagnitude() const
+    {
+        SampleType result = 0;
+        
+        for( int s = 0; s < numActive; ++s )
+        {
+            for( size_t lane = 0; lane < SIMDType::size(); ++lane )
+                result = juce::jmax(result, std::abs(z1[s].get(lane)), std::abs(z2[s].get(lane)));
+        }
+        
+        return result;
+    }
+
+    void process(const juce::dsp::AudioBlock<SampleType>& block)
+    {
+        const auto numChannels = juce::jmin((int)block.getNumChannels(), getMaxNumChannels());
+        const auto numSamples = (int)block.getNumSamples();
+        const auto lanes = (int)SIMDType::size();
+
+        if( processFunction == nullptr || interleaved.empty() )
+            return;
+
+        auto* raw = reinterpret_cast<SampleType*>(interleaved.data());
+
+        //хост может прислать блок больше обещанного, поэтому идем кусками размером с буфер
+        for( int start = 0; start < numSamples; start += (int)interleaved.size() )
+        {
+            const auto n = juce::jmin((int)interleaved.size(), numSamples - start);
+
+            for( int ch = 0; ch < lanes; ++ch )
+            {
+                if( ch < numChannels )
+                {
+                    auto* src = block.getChannelPointer((size_t)ch) + start;
+                    for( int i = 0; i < n; ++i )
+                        raw[i * lanes + ch] = src[i];
+                }
+                else
+                {
+                    for( int i = 0; i < n; ++i )
+                        raw[i * lanes + ch] = 0;
+                }
+            }
+
+            (this->*processFunction)(n);
+
+            for( int ch = 0; ch < numChannels; ++ch )
+            {
+                auto* dest = block.getChannelPointer((size_t)ch) + start;
+                for( int i = 0; i < n; ++i )
+                    dest[i] = raw[i * lanes + ch];
+            }
+        }
+    }
+private:
+    using ProcessFunction = void (SIMDBiquadCascade::*)(int);
+
+    template<int NumStages>
+    void processInterleaved(int numSamples)
+    {
+        //локальные копии, чтобы компилятор держал весь каскад в регистрах
+        std::array<SIMDType, NumStages> c0, c1, c2, d1, d2, s1, s2;
+
+        for( int s = 0; s < NumStages; ++s )
+        {
+            c0[s] = b0[s]; c1[s] = b1[s]; c2[s] = b2[s];
+            d1[s] = a1[s]; d2[s] = a2[s];
+            s1[s] = z1[s]; s2[s] = z2[s];
+        }
+
+        for( int i = 0; i < numSamples; ++i )
+        {
+            auto x = interleaved[(size_t)i];
+
+            //транспонированная прямая форма II, как в juce::dsp::IIR::Filter
+            for( int s = 0; s < NumStages; ++s )
+            {
+                auto y = c0[s] * x + s1[s];
+                s1[s] = c1[s] * x - d1[s] * y + s2[s];
+                s2[s] = c2[s] * x - d2[s] * y;
+                x = y;
+            }
+
+            interleaved[(size_t)i] = x;
+        }
+
+        for( int s = 0; s < NumStages; ++s )
+        {
+            z1[s] = s1[s];
+            z2[s] = s2[s];
+        }
+    }
+
+    static ProcessFunction getProcessFunction(int numStages)
+    {
+        switch( numStages )
+        {
+            case 1: return &SIMDBiquadCascade::processInterleaved<1>;
+            case 2: return &SIMDBiquadCascade::processInterleaved<2>;
+            case 3: return &SIMDBiquadCascade::processInterleaved<3>;
+            case 4: return &SIMDBiquadCascade::processInterleaved<4>;
+            case 5: return &SIMDBiquadCascade::processInterleaved<5>;
+            case 6: return &SIMDBiquadCascade::processInterleaved<6>;
+            case 7: return &SIMDBiquadCascade::processInterleaved<7>;
+            case 8: return &SIMDBiquadCascade::processInterleaved<8>;
+            case 9: return &SIMDBiquadCascade::processInterleaved<9>;
+            default: return nullptr;
+        }
+    }
+
+    //активные ступени подряд
+    std::array<SIMDType, numSlots> b0, b1, b2, a1, a2;
+    std::array<SIMDType, numSlots> z1, z2;
+    std::array<int, numSlots> activeSlots {};
+    int numActive = 0;
+    ProcessFunction processFunction = nullptr;
+
+    //сохраненное состояние по слотам, пока ступени переупаковываются
+    std::array<SIMDType, numSlots> slotZ1, slotZ2;
+
+    std::vector<SIMDType> interleaved;
+};
+
+//коэффициенты по слотам каскада, nullptr - ступень выключена
+using CascadeStages = std::array<const BiquadCoefficients*, SIMDBiquadCascade<float>::numSlots>;
@@ -0,0 +1,343 @@
+/*
+  ==============================================================================
+
+    Линейно-фазовый режим: симметричный КИХ фильтр с той же АЧХ, что и каскад
+    биквадов, и равномерно разбитая на части свертка через FFT.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <complex>
+#include <vector>
+
+#include "BiquadCascade.h"
+
+/**
+ спектры частей ядра свертки. каждая часть - partitionSize отсчетов ядра,
+ дополненные нулями до 2 * partitionSize, то есть partitionSize + 1 комплексных бинов.
+ */
+struct LinearPhaseKernel
+{
+    void prepare(int numPartitionsToUse, int numBins)
+    {
+        numPartitions = numPartitionsToUse;
+        spectra.assign((size_t)(numPartitions * numBins), {});
+    }
+
+    int numPartitions = 0;
+    std::vector<std::complex<float>> spectra;
+};
+
+/**
+ строит ядро по коэффициентам каскада: считает |H| на сетке частот,
+ обратным FFT получает нуль-фазовую импульсную характеристику, сдвигает ее на половину длины,
+ взвешивает окном Блэкмана и раскладывает по частям для свертки.
+ вызывается только из потока расчета коэффициентов, вся память выделяется в prepare.
+ */
+struct LinearPhaseDesigner
+{
+    static constexpr int partitionSize = 256;
+    static constexpr int numBins = partitionSize + 1;
+
+    //~80 мс ядра: 4096 отсчетов на 44.1/48 кГц, 16384 на 192 кГц
+    static int getKernelLength(double sampleRate)
+    {
+        return juce::nextPowerOfTwo((int)std::ceil(sampleRate * 0.08));
+    }
+
+    //половина ядра плюс одна часть, которую свертка копит перед первым FFT
+    static int getLatencySamples(double sampleRate)
+    {
+        return getKernelLength(sampleRate) / 2 + partitionSize;
+    }
+
+    void prepare(double sampleRate)
+    {
+        kernelLength = getKernelLength(sampleRate);
+
+        kernelFFT = std::make_unique<juce::dsp::FFT>(juce::roundToInt(std::log2(kernelLength)));
+        partitionFFT = std::make_unique<juce::dsp::FFT>(juce::roundToInt(std::log2(2 * partitionSize)));
+
+        impulse.assign((size_t)(2 * kernelLength), 0.f);
+        partition.assign((size_t)(4 * partitionSize), 0.f);
+
+        window.resize((size_t)kernelLength);
+        for( int n = 0; n < kernelLength; ++n )
+        {
+            //периодическое окно: window[0] = 0, остальное симметрично относительно kernelLength / 2
+            const auto phase = juce::MathConstants<double>::twoPi * n / kernelLength;
+            window[(size_t)n] = (float)(0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase));
+        }
+    }
+
+    int getNumPartitions() const { return kernelLength / partitionSize; }
+
+    template<size_t NumSlots>
+    void design(LinearPhaseKernel& kernel, const std::array<const BiquadCoefficients*, NumSlots>& stages)
+    {
+        jassert(kernel.numPartitions == getNumPartitions());
+
+        const auto half = kernelLength / 2;
+
+        //нуль-фазовый спектр: только модуль, мнимая часть 0
+        for( int k = 0; k <= half; ++k )
+        {
+            const auto omega = juce::MathConstants<double>::twoPi * k / kernelLength;
+            const auto cos1 = std::cos(omega);
+            const auto cos2 = std::cos(2.0 * omega);
+
+            double magnitudeSquared = 1.0;
+
+            for( auto* stage : stages )
+            {
+                if( stage == nullptr )
+                    continue;
+
+                const auto& c = *stage;
+                const auto b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+
+                const auto numerator = b0 * b0 + b1 * b1 + b2 * b2 + 2.0 * (b0 * b1 + b1 * b2) * cos1 + 2.0 * b0 * b2 * cos2;
+                const auto denominator = 1.0 + a1 * a1 + a2 * a2 + 2.0 * (a1 + a1 * a2) * cos1 + 2.0 * a2 * cos2;
+
+                magnitudeSquared *= numerator / denominator;
+            }
+
+            impulse[(size_t)(2 * k)] = (float)std::sqrt(juce::jmax(0.0, magnitudeSquared));
+            impulse[(size_t)(2 * k + 1)] = 0.f;
+        }
+
+        //верхнюю половину тоже заполняем: не все реализации FFT восстанавливают ее сами
+        for( int k = half + 1; k < kernelLength; ++k )
+        {
+            impulse[(size_t)(2 * k)] = impulse[(size_t)(2 * (kernelLength - k))];
+            impulse[(size_t)(2 * k + 1)] = 0.f;
+        }
+
+        kernelFFT->performRealOnlyInverseTransform(impulse.data());
+
+        //impulse симметричен относительно 0, сдвигаем центр в half
+        for( int p = 0; p < getNumPartitions(); ++p )
+        {
+            std::fill(partition.begin(), partition.end(), 0.f);
+
+            for( int i = 0; i < partitionSize; ++i )
+            {
+                const auto n = p * partitionSize + i;
+                partition[(size_t)i] = impulse[(size_t)((n + half) % kernelLength)] * window[(size_t)n];
+            }
+
+            partitionFFT->performRealOnlyForwardTransform(partition.data(), true);
+
+            auto* bins = reinterpret_cast<const std::complex<float>*>(partition.data());
+            std::copy(bins, bins + numBins, kernel.spectra.begin() + p * numBins);
+        }
+    }
+private:
+    int kernelLength = 0;
+
+    std::unique_ptr<juce::dsp::FFT> kernelFFT, partitionFFT;
+    std::vector<float> impulse, partition, window;
+};
+
+/**
+ равномерно разбитая свертка overlap-save: вход копится частями по partitionSize,
+ спектр каждой части кладется в линию задержки и умножается на все части ядра.
+ новое ядро не подменяется сразу: одну часть выход считается со старым и новым ядром
+ и линейно переходит от одного к другому.
+ работает во float, в режиме double сэмплы приводятся при копировании.
+ */
+struct PartitionedConvolver
+{
+    static constexpr int partitionSize = LinearPhaseDesigner::partitionSize;
+    static constexpr int numBins = LinearPhaseDesigner::numBins;
+
+    void prepare(int numChannelsToUse, int numPartitionsToUse)
+    {
+        numChannels = numChannelsToUse;
+        numPartitions = numPartitionsToUse;
+
+        fft = std::make_unique<juce::dsp::FFT>(juce::roundToInt(std::log2(2 * partitionSize)));
+
+        current.prepare(numPartitions, numBins);
+        previous.prepare(numPartitions, numBins);
+        hasKernel = false;
+        crossfadePending = false;
+
+        inputs.assign((size_t)(numChannels * 2 * partitionSize), 0.f);
+        outputs.assign((size_t)(numChannels * partitionSize), 0.f);
+        delayLines.assign((size_t)(numChannels * numPartitions * numBins), {});
+
+        accumulator.assign((size_t)numBins, {});
+        previousAccumulator.assign((size_t)numBins, {});
+        scratch.assign((size_t)(4 * partitionSize), 0.f);
+        previousScratch.assign((size_t)(4 * partitionSize), 0.f);
+
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(inputs.begin(), inputs.end(), 0.f);
+        std::fill(outputs.begin(), outputs.end(), 0.f);
+        std::fill(delayLines.begin(), delayLines.end(), std::complex<float>());
+
+        position = 0;
+        delayLineIndex = 0;
+        crossfadePending = false;
+    }
+
+    /**
+     забирает спектры из kernel обменом векторов, без копирования и выделения памяти.
+     в kernel остаются спектры, которые больше не нужны, их перезапишет следующий расчет.
+     */
+    void setKernel(LinearPhaseKernel& kernel)
+    {
+        if( kernel.numPartitions != numPartitions )
+            return;
+
+        //если предыдущий переход еще не начался, слышно все еще ядро из previous
+        if( ! crossfadePending )
+            std::swap(previous.spectra, current.spectra);
+
+        std::swap(current.spectra, kernel.spectra);
+
+        crossfadePending = hasKernel;
+        hasKernel = true;
+    }
+
+    template<typename SampleType>
+    void process(const juce::dsp::AudioBlock<SampleType>& block)
+    {
+        const auto channelsToProcess = juce::jmin((int)block.getNumChannels(), numChannels);
+        const auto numSamples = (int)block.getNumSamples();
+
+        if( ! hasKernel || numPartitions == 0 )
+        {
+            block.clear();
+            return;
+        }
+
+        for( int start = 0; start < numSamples; )
+        {
+            const auto n = juce::jmin(partitionSize - position, numSamples - start);
+
+            for( int ch = 0; ch < channelsToProcess; ++ch )
+            {
+                auto* samples = block.getChannelPointer((size_t)ch) + start;
+                auto* input = getInput(ch) + partitionSize + position;
+                auto* output = getOutput(ch) + position;
+
+                for( int i = 0; i < n; ++i )
+                {
+                    input[i] = (float)samples[i];
+                    samples[i] = (SampleType)output[i];
+                }
+            }
+
+            position += n;
+            start += n;
+
+            if( position == partitionSize )
+            {
+                processPartition(channelsToProcess);
+                position = 0;
+            }
+        }
+    }
+private:
+    float* getInput(int channel) { return inputs.data() + channel * 2 * partitionSize; }
+    float* getOutput(int channel) { return outputs.data() + channel * partitionSize; }
+    std::complex<float>* getDelayLine(int channel) { return delayLines.data() + channel * numPartitions * numBins; }
+
+    void processPartition(int channelsToProcess)
+    {
+        const auto crossfade = crossfadePending;
+
+        for( int ch = 0; ch < channelsToProcess; ++ch )
+        {
+            auto* input = getInput(ch);
+            auto* delayLine = getDelayLine(ch);
+
+            //спектр окна из предыдущей и текущей части
+            std::copy(input, input + 2 * partitionSize, scratch.begin());
+            fft->performRealOnlyForwardTransform(scratch.data(), true);
+
+            auto* bins = reinterpret_cast<const std::complex<float>*>(scratch.data());
+            std::copy(bins, bins + numBins, delayLine + delayLineIndex * numBins);
+
+            multiplyAccumulate(accumulator, current, delayLine);
+            if( crossfade )
+                multiplyAccumulate(previousAccumulator, previous, delayLine);
+
+            //последние partitionSize отсчетов обратного FFT - корректная линейная свертка
+            inverse(scratch, accumulator);
+
+            auto* output = getOutput(ch);
+
+            if( crossfade )
+            {
+                inverse(previousScratch, previousAccumulator);
+
+                for( int i = 0; i < partitionSize; ++i )
+                {
+                    const auto t = (float)(i + 1) / partitionSize;
+                    output[i] = scratch[(size_t)(partitionSize + i)] * t + previousScratch[(size_t)(partitionSize + i)] * (1.f - t);
+                }
+            }
+            else
+            {
+                std::copy(scratch.begin() + partitionSize, scratch.begin() + 2 * partitionSize, output);
+            }
+
+            std::copy(input + partitionSize, input + 2 * partitionSize, input);
+        }
+
+        crossfadePending = false;
+        delayLineIndex = (delayLineIndex + 1) % numPartitions;
+    }
+
+    void multiplyAccumulate(std::vector<std::complex<float>>& dest, const LinearPhaseKernel& kernel, const std::complex<float>* delayLine)
+    {
+        std::fill(dest.begin(), dest.end(), std::complex<float>());
+
+        //часть p ядра умножается на спектр входа p частей назад
+        for( int p = 0; p < numPartitions; ++p )
+        {
+            const auto index = (delayLineIndex - p + numPartitions) % numPartitions;
+            const auto* x = delayLine + index * numBins;
+            const auto* h = kernel.spectra.data() + p * numBins;
+
+            for( int k = 0; k < numBins; ++k )
+                dest[(size_t)k] += x[k] * h[k];
+        }
+    }
+
+    void inverse(std::vector<float>& dest, const std::vector<std::complex<float>>& spectrum)
+    {
+        auto* bins = reinterpret_cast<std::complex<float>*>(dest.data());
+        const auto fftSize = 2 * partitionSize;
+
+        std::copy(spectrum.begin(), spectrum.end(), bins);
+        for( int k = numBins; k < fftSize; ++k )
+            bins[k] = std::conj(spectrum[(size_t)(fftSize - k)]);
+
+        fft->performRealOnlyInverseTransform(dest.data());
+    }
+
+    int numChannels = 0, numPartitions = 0;
+    int position = 0, delayLineIndex = 0;
+
+    bool hasKernel = false, crossfadePending = false;
+    LinearPhaseKernel current, previous;
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+
+    std::vector<float> inputs, outputs;
+    std::vector<std::complex<float>> delayLines;
+    std::vector<std::complex<float>> accumulator, previousAccumulator;
+    std::vector<float> scratch, previousScratch;
+};
@@ -229,8 +229,7 @@ juce::String RotarySliderWithLabels::getDisplayString() const
 //==============================================================================
 ResponseCurveComponent::ResponseCurveComponent(SimpleEQAudioProcessor& p) :
 audioProcessor(p),
-leftPathProducer(audioProcessor.leftChannelFifo),
-rightPathProducer(audioProcessor.rightChannelFifo)
+pathProducer(audioProcessor.leftChannelFifo, audioProcessor.rightChannelFifo)
 {
     const auto& params = audioProcessor.getParameters();
     for( auto param : params )
@@ -238,13 +237,23 @@ rightPathProducer(audioProcessor.rightChannelFifo)
         param->addListener(this);
     }
 
-    updateChain();
+    pullChainSnapshot();
+    updateCurveCoefficients();
+    updateAnalyzerResolution();
     
-    startTimerHz(60);
+    //когерентность едет с кадром; память под самый большой FFT, чтобы поток анализатора ее не выделял
+    const auto maxNumBins = (size_t)FFTDataGenerator<std::vector<float>>::getMaxFFTSize() / 2;
+    analyzerFrames.prepareBuffers([maxNumBins](AnalyzerFrame& frame) { frame.coherence.reserve(maxNumBins); });
+    analyzerCoherence.reserve(maxNumBins);
+    
+    analyzerThread.startThread();
+    startTimerHz(maxFramesPerSecond);
 }
 
 ResponseCurveComponent::~ResponseCurveComponent()
 {
+    analyzerThread.stopThread(1000);
+    
     const auto& params = audioProcessor.getParameters();
     for( auto param : params )
     {
@@ -259,50 +268,23 @@ void ResponseCurveComponent::updateResponseCurve()
     
     auto w = responseArea.getWidth();
     
-    auto& lowcut = monoChain.get<ChainPositions::LowCut>();
-    auto& peak = monoChain.get<ChainPositions::Peak>();
-    auto& highcut = monoChain.get<ChainPositions::HighCut>();
+    if( w <= 0 || curveCoefficients.sampleRate <= 0 )
+    {
+        responseCurve.clear();
+        return;
+    }
     
-    auto sampleRate = audioProcessor.getSampleRate();
+    const auto& coefficients = curveCoefficients;
     
-    std::vector<double> mags;
+    //пересчитываются только полосы, чьи коэффициенты изменились
+    responseEvaluator.prepare(w, coefficients.sampleRate);
     
-    mags.resize(w);
+    const auto stages = getCascadeStages(coefficients);
+    responseEvaluator.setBand(ResponseEvaluator::lowCutBand, stages.data(), 4);
+    responseEvaluator.setBand(ResponseEvaluator::peakBand, stages.data() + 4, 1);
+    responseEvaluator.setBand(ResponseEvaluator::highCutBand, stages.data() + 5, 4);
     
-    for( int i = 0; i < w; ++i )
-    {
-        double mag = 1.f;
-        auto freq = mapToLog10(double(i) / double(w), 20.0, 20000.0);
-        
-        if(! monoChain.isBypassed<ChainPositions::Peak>() )
-            mag *= peak.coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        
-        if( !monoChain.isBypassed<ChainPositions::LowCut>() )
-        {
-            if( !lowcut.isBypassed<0>() )
-                mag *= lowcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !lowcut.isBypassed<1>() )
-                mag *= lowcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !lowcut.isBypassed<2>() )
-                mag *= lowcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !lowcut.isBypassed<3>() )
-                mag *= lowcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        }
-        
-        if( !monoChain.isBypassed<ChainPositions::HighCut>() )
-        {
-            if( !highcut.isBypassed<0>() )
-                mag *= highcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !highcut.isBypassed<1>() )
-                mag *= highcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !highcut.isBypassed<2>() )
-                mag *= highcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( !highcut.isBypassed<3>() )
-                mag *= highcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        }
-            
-        mags[i] = Decibels::gainToDecibels(mag);
-    }
+    const auto& mags = responseEvaluator.getDecibels();
     
     responseCurve.clear();
     
@@ -324,31 +306,47 @@ void ResponseCurveComponent::updateResponseCurve()
 void ResponseCurveComponent::paint (juce::Graphics& g)
 {
     using namespace juce;
-    // (Наш компонент непрозрачен, поэтому мы должны полностью заполнить фон сплошным цветом)
-    g.fillAll (Colours::black);
-
-    drawBackgroundGrid(g);
+    const auto paintStart = Time::getMillisecondCounterHiRes();
+    
+    backgroundLayer.draw(g, getLocalBounds(), [this](Graphics& layer)
+    {
+        // (Наш компонент непрозрачен, поэтому мы должны полностью заполнить фон сплошным цветом)
+        layer.fillAll (Colours::black);
+        drawBackgroundGrid(layer);
+    });
     
     auto responseArea = getAnalysisArea();
     
     if( shouldShowFFTAnalysis )
     {
-        auto leftChannelFFTPath = leftPathProducer.getPath();
-        leftChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+        //пути не копируем, сдвиг в область анализатора - преобразованием при обводке
+        const auto toResponseArea = AffineTransform::translation((float)responseArea.getX(), (float)responseArea.getY());
         
         g.setColour(Colour(97u, 100u, 200u)); //purple-
-        g.strokePath(leftChannelFFTPath, PathStrokeType(1.f));
-        
-        auto rightChannelFFTPath = rightPathProducer.getPath();
-        rightChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+        g.strokePath(leftChannelFFTPath, PathStrokeType(1.f), toResponseArea);
         
         g.setColour(Colour(215u, 201u, 134u));
-        g.strokePath(rightChannelFFTPath, PathStrokeType(1.f));
+        g.strokePath(rightChannelFFTPath, PathStrokeType(1.f), toResponseArea);
     }
     
     g.setColour(Colours::white);
     g.strokePath(responseCurve, PathStrokeType(2.f));
     
+    overlayLayer.draw(g, getLocalBounds(), [this](Graphics& layer)
+    {
+        drawBorder(layer);
+        drawTextLabels(layer);
+        
+        layer.setColour(Colours::orange);
+        layer.drawRoundedRectangle(getRenderArea().toFloat(), 4.f, 1.f);
+    });
+    
+    averagePaintMs += 0.1 * (Time::getMillisecondCounterHiRes() - paintStart - averagePaintMs);
+}
+
+void ResponseCurveComponent::drawBorder(juce::Graphics& g)
+{
+    using namespace juce;
     Path border;
     
     border.setUsingNonZeroWinding(false);
@@ -359,11 +357,6 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
     g.setColour(Colours::black);
     
     g.fillPath(border);
-    
-    drawTextLabels(g);
-    
-    g.setColour(Colours::orange);
-    g.drawRoundedRectangle(getRenderArea().toFloat(), 4.f, 1.f);
 }
 
 std::vector<float> ResponseCurveComponent::getFrequencies()
@@ -511,8 +504,14 @@ void ResponseCurveComponent::resized()
 {
     using namespace juce;
     
+    backgroundLayer.invalidate();
+    overlayLayer.invalidate();
+    
     responseCurve.preallocateSpace(getWidth() * 3);
     updateResponseCurve();
+    
+    const juce::SpinLock::ScopedLockType sl(analysisBoundsLock);
+    analysisBounds = getAnalysisArea().toFloat();
 }
 
 void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float newValue)
@@ -520,119 +519,476 @@ void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float new
     parametersChanged.set(true);
 }
 
-void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate, bool autoON)
+//==============================================================================
+AutoEQJob::AutoEQJob(std::vector<float> spectrum, float binWidthToUse, ChainSettings settingsToUse,
+                     std::shared_ptr<std::atomic<double>> progressToUse, std::function<void(const ChainSettings&)> onFinishedToUse) :
+juce::ThreadPoolJob("SimpleEQ Auto EQ"),
+summData(std::move(spectrum)),
+binWidth(binWidthToUse),
+settings(settingsToUse),
+progress(std::move(progressToUse)),
+onFinished(std::move(onFinishedToUse))
 {
-    juce::AudioBuffer<float> tempIncomingBuffer;
-    while( leftChannelFifo->getNumCompleteBuffersAvailable() > 0 )
+}
+
+juce::ThreadPoolJob::JobStatus AutoEQJob::runJob()
+{
+    *progress = 0.0;
+    
+    if( ! generateNewFilters(settings) || shouldExit() )
+        return jobHasFinished;
+    
+    //результат применяется в потоке сообщений; если редактор уже закрыт, onFinished сам это проверит
+    juce::MessageManager::callAsync([onFinished = onFinished, result = settings]()
     {
-        if( leftChannelFifo->getAudioBuffer(tempIncomingBuffer) )
-        {
-            auto size = tempIncomingBuffer.getNumSamples();
+        onFinished(result);
+    });
+    
+    return jobHasFinished;
+}
 
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-                                              monoBuffer.getReadPointer(0, size),
-                                              monoBuffer.getNumSamples() - size);
+bool AutoEQJob::generateNewFilters(ChainSettings& cainSettings)
+{
+    // получили среднее значение для каждой полученной чистоты
+    int size = (int)summData.size();
 
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-                                              tempIncomingBuffer.getReadPointer(0, 0),
-                                              size);
-            
-            leftChannelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, -48.f);
-        }
+    int lowpick = 0;
+    int higtpick = size - 1;
+    float higtMax = 0;
+    float lowMax = summData[0];
+    if (lowMax == 0) { return true; }
+    for (int i = 1; lowMax <= summData[i]; i++)
+    {
+        lowMax = summData[i];
+        lowpick = i;
     }
-    
-    const auto fftSize = leftChannelFFTDataGenerator.getFFTSize();
-    const auto binWidth = sampleRate / double(fftSize);
+    *progress = 0.2;
 
-    while( leftChannelFFTDataGenerator.getNumAvailableFFTDataBlocks() > 0 )
+    for (int i = size - 1; summData[i] == 0 && i > 0; i--)
     {
-        std::vector<float> fftData;
-        if( leftChannelFFTDataGenerator.getFFTData( fftData) )
+        higtpick = i - 1;
+    }
+    std::vector<int> firstHihtPics;
+    firstHihtPics.push_back(higtpick);
+    higtMax = summData[higtpick];
+
+
+    float rangeHigtSorce = 0.1;
+    auto tmpnormalizedRange = juce::mapFromLog10(higtpick*binWidth, 20.f, 20000.f);
+    int numOfIterSerch = 5;
+    for (int i = 0; i < numOfIterSerch && tmpnormalizedRange > 0.5; i++)
+    {
+        if (shouldExit()) { return false; }
+
+        tmpnormalizedRange = tmpnormalizedRange - rangeHigtSorce;
+        higtpick = std::floor(juce::mapToLog10(tmpnormalizedRange, 20.f, 20000.f)/ binWidth);
+
+        for (int j = higtpick; j <= firstHihtPics.back(); j++)
         {
-            pathProducer.generatePath(fftData, fftBounds, fftSize, binWidth, -48.f);
-            if (autoON)
+            if (summData[j] >= higtMax)
             {
-                itWasAnalized = true;
-                pushFFTSamle(pathProducer.analize(fftData, fftSize, binWidth, -48.f));
-            }
-            else if (itWasAnalized)
-            {
-                cleerRetorData();
-                itWasAnalized = false;
+                higtMax = summData[j];
+                higtpick = j;
             }
+         
+        }
+        if (higtpick == firstHihtPics.back())
+        {
+            rangeHigtSorce += 0.1;
+            i--;
         }
+        else
+        {
+            firstHihtPics.push_back(higtpick);
+            *progress = 0.2 + 0.6 * (double)(firstHihtPics.size() - 1) / numOfIterSerch;
+        }
+    }
+
+    if (shouldExit()) { return false; }
+    *progress = 0.8;
+    
+    /// /////////////////////////
+
+
+    cainSettings.highCutSlope = Slope::Slope_12;
+    if (firstHihtPics.size() >= 3)
+    {
+        higtpick = firstHihtPics[1];
+
+        if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[1] * binWidth, 20.f, 20000.f)) < 5) { cainSettings.highCutSlope = Slope::Slope_48; }
+        else if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[1] * binWidth, 20.f, 20000.f)) < 7) { cainSettings.highCutSlope = Slope::Slope_36; }
+        else if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[1] * binWidth, 20.f, 20000.f)) < 11) { cainSettings.highCutSlope = Slope::Slope_24; }
     }
-    while( pathProducer.getNumPathsAvailable() > 0 )
+    if (firstHihtPics.size() == 2)
     {
-        pathProducer.getPath( leftChannelFFTPath );
+        higtpick = firstHihtPics[1];
+
+        if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[0] * binWidth, 20.f, 20000.f)) < 5) { cainSettings.highCutSlope = Slope::Slope_48; }
+        else if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[0] * binWidth, 20.f, 20000.f)) < 7) { cainSettings.highCutSlope = Slope::Slope_36; }
+        else if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[0] * binWidth, 20.f, 20000.f)) < 11) { cainSettings.highCutSlope = Slope::Slope_24; }
+    }
+    if (firstHihtPics.size() == 1)
+    {
+        higtpick = firstHihtPics[0];
     }
+    auto a = juce::mapToLog10((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f)+0.1f), 20.f, 20000.f);
+    cainSettings.highCutFreq = 20 + std::floor(a);
+
+    float normalizeLowpic = juce::mapFromLog10((lowpick+1) * binWidth, 20.f, 20000.f);
+    float normalizeHigtpic = juce::mapFromLog10((higtpick+1) * binWidth, 20.f, 20000.f);
+    float normalizeMidpic = normalizeLowpic + (normalizeHigtpic - normalizeLowpic) / 2;
+
+    a = juce::mapToLog10(normalizeMidpic, 20.f, 20000.f) / binWidth;
+    int midpic = std::floor(a);
+    float midSlope = 0;
+    float midQuality = 0;
+
+    if (normalizeHigtpic - normalizeLowpic <= 0)
+    { midpic = 0;}
+    else
+    {
+        midSlope = 24 * (std::max(summData[lowpick], summData[higtpick]) - summData[midpic])/1000;
+        midQuality = normalizeHigtpic - normalizeLowpic;
+        midQuality = 1/(midQuality * 6 + 1);
+    }
+
+    cainSettings.peakGainInDecibels = midSlope;
+    cainSettings.peakQuality = midQuality;
+    cainSettings.peakFreq = 20 + midpic * binWidth;
+    cainSettings.lowCutFreq = 20 + lowpick * binWidth;
+    cainSettings.lowCutSlope = Slope::Slope_24;
+    cainSettings.peakBypassed = true;
+    cainSettings.highCutBypassed = true;
+    cainSettings.lowCutBypassed = true;
+
+    *progress = 1.0;
+    return true;
 }
 
-void ResponseCurveComponent::timerCallback()
+
+void PathProducer::setResolution(AnalyzerResolution resolution)
 {
-    //тут добавим еще один if который дублирует логику но внедряет в нее анализ и изменение дорожек.
-    if (shouldShowFFTAnalysis)
+    switch( resolution )
     {
-        auto fftBounds = getAnalysisArea().toFloat();
-        auto sampleRate = audioProcessor.getSampleRate();
+        case AnalyzerResolution_LowCPU:
+            fftOrder = order2048;
+            resolutionFramesPerSecond = 30.0;
+            break;
+        case AnalyzerResolution_Standard:
+            fftOrder = order2048;
+            resolutionFramesPerSecond = 60.0;
+            break;
+        case AnalyzerResolution_Fine:
+            fftOrder = order4096;
+            resolutionFramesPerSecond = 60.0;
+            break;
+        case AnalyzerResolution_HighRes:
+            fftOrder = order8192;
+            resolutionFramesPerSecond = 60.0;
+            break;
+    }
+}
 
-        leftPathProducer.process(fftBounds, sampleRate, recordPicsEnable);
-        rightPathProducer.process(fftBounds, sampleRate, recordPicsEnable);
+int PathProducer::getHopSize(double sampleRate) const
+{
+    const auto fftSize = fftDataGenerator.getFFTSize();
+    const auto fps = hopConfigured ? framesPerSecond.load() : resolutionFramesPerSecond.load();
+    
+    auto hopSize = fps > 0.0 ? juce::roundToInt(sampleRate / fps)
+                             : juce::roundToInt(fftSize * (1.f - overlap.load()));
+    
+    //не чаще, чем с перекрытием 87.5%
+    return juce::jmax(fftSize / 8, hopSize);
+}
+
+void PathProducer::pushSamples(int channel, const float* samples, int numSamples)
+{
+    const auto fftSize = windowBuffer.getNumSamples();
+    
+    //в окно попадают только последние fftSize сэмплов, более старые сразу пропускаем
+    if( numSamples > fftSize )
+    {
+        samples += numSamples - fftSize;
+        numSamples = fftSize;
     }
     
+    if( numSamples <= 0 )
+        return;
+    
+    //сдвигаем окно и дописываем новые сэмплы в конец
+    auto* window = windowBuffer.getWritePointer(channel);
+    std::memmove(window, window + numSamples, sizeof(float) * (size_t)(fftSize - numSamples));
+    std::memcpy(window + fftSize - numSamples, samples, sizeof(float) * (size_t)numSamples);
+}
 
-    if( parametersChanged.compareAndSetBool(false, true) )
+bool PathProducer::process(juce::Path& leftPath, juce::Path& rightPath, juce::Rectangle<float> fftBounds, double sampleRate, bool autoON)
+{
+    timings = {};
+    const auto start = juce::Time::getHighResolutionTicks();
+    
+    //все планы FFT готовы заранее, переключение ничего не выделяет.
+    //накопленные для авто-эквалайзера спектры другой длины больше не подходят
+    const auto requestedOrder = fftOrder.load();
+    if( requestedOrder != fftDataGenerator.getOrder() )
+    {
+        fftDataGenerator.changeOrder(requestedOrder);
+        cleerRetorData();
+        hasFFTData = false;
+    }
+    
+    //после простоя в кольцах и в окне лежит старый звук, анализ начинается заново с того, что придет
+    if( discardRequested.exchange(false) )
     {
-        updateChain();
-        updateResponseCurve(); // при нажатии на слайдоры
+        for( auto* fifo : { leftChannelFifo, rightChannelFifo } )
+            fifo->finishedRead(fifo->getNumSamplesAvailable());
+        
+        windowBuffer.clear();
+        samplesSinceLastFFT = 0;
+    }
+    
+    //читаем прямо из колец, все что накопилось с прошлого кадра.
+    //оба кольца пишутся в одном processBlock, поэтому читаем поровну, чтобы каналы не разъехались
+    const auto numToRead = juce::jmin(leftChannelFifo->getNumSamplesAvailable(), rightChannelFifo->getNumSamplesAvailable());
+    
+    int channel = 0;
+    for( auto* fifo : { leftChannelFifo, rightChannelFifo } )
+    {
+        auto spans = fifo->prepareToRead(numToRead);
+        pushSamples(channel, spans.data1, spans.size1);
+        pushSamples(channel, spans.data2, spans.size2);
+        fifo->finishedRead(spans.getTotalSize());
+        ++channel;
     }
     
-    repaint();
+    samplesSinceLastFFT += numToRead;
+    
+    const auto hopSize = getHopSize(sampleRate);
+    const auto drained = juce::Time::getHighResolutionTicks();
+    timings.drainMs = juce::Time::highResolutionTicksToSeconds(drained - start) * 1000.0;
+    
+    //если за проход набралось несколько шагов, считаем только последний кадр:
+    //рисуется все равно только он, а окно уже содержит самые свежие сэмплы
+    if( samplesSinceLastFFT >= hopSize )
+    {
+        fftDataGenerator.produceFFTDataForRendering(windowBuffer, -48.f);
+        ++timings.numFFTFrames;
+        
+        samplesSinceLastFFT %= hopSize;
+    }
+    
+    const auto transformed = juce::Time::getHighResolutionTicks();
+    timings.fftMs = juce::Time::highResolutionTicksToSeconds(transformed - drained) * 1000.0;
+    
+    const auto isNewFrame = fftDataGenerator.pullFFTData();
+    hasFFTData = hasFFTData || isNewFrame;
+    
+    //без нового кадра пути перестраиваем только под новые размеры, по последнему кадру
+    if( ! hasFFTData || ! (isNewFrame || fftBounds != generatedBounds) )
+        return false;
+    
+    generatedBounds = fftBounds;
+    
+    const auto fftSize = fftDataGenerator.getFFTSize();
+    const auto numBins = fftDataGenerator.getNumBins();
+    const auto binWidth = sampleRate / double(fftSize);
+    
+    auto* fftData = fftDataGenerator.getFFTData().data();
+    auto getSpectrum = [fftData, numBins](StereoSpectrum s) { return fftData + (int)s * numBins; };
+    
+    const auto midSide = stereoAnalysisMode == StereoAnalysisMode::midSide;
+    leftPathGenerator.generatePath(leftPath, getSpectrum(midSide ? StereoSpectrum::mid : StereoSpectrum::left), fftBounds, fftSize, binWidth, -48.f);
+    rightPathGenerator.generatePath(rightPath, getSpectrum(midSide ? StereoSpectrum::side : StereoSpectrum::right), fftBounds, fftSize, binWidth, -48.f);
+    
+    if( isNewFrame )
+    {
+        auto* coherenceData = getSpectrum(StereoSpectrum::coherence);
+        coherence.assign(coherenceData, coherenceData + numBins);
+        
+        //авто-эквалайзер, как и раньше, слушает левый канал
+        if (autoON)
+        {
+            itWasAnalized = true;
+            pushFFTSamle(leftPathGenerator.analize(getSpectrum(StereoSpectrum::left), fftSize, binWidth, -48.f), (float)binWidth);
+        }
+        else if (itWasAnalized)
+        {
+            cleerRetorData();
+            itWasAnalized = false;
+        }
+    }
+    
+    timings.pathMs = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - transformed) * 1000.0;
+    return true;
 }
 
-void ResponseCurveComponent::updateChain(ChainSettings settings) {
-    auto chainSettings = settings;
+void ResponseCurveComponent::AnalyzerThread::run()
+{
+    while( ! threadShouldExit() )
+    {
+        //редактор не виден: спим, пока timerCallback не разбудит
+        if( component.analyzerIdle )
+        {
+            wait(-1);
+            continue;
+        }
+        
+        component.analyze();
+        wait(1000 / component.framesPerSecond.load());
+    }
+}
 
-    monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    monoChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    monoChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+void ResponseCurveComponent::analyze()
+{
+    //тут добавим еще один if который дублирует логику но внедряет в нее анализ и изменение дорожек.
+    if( ! shouldShowFFTAnalysis )
+        return;
+    
+    juce::Rectangle<float> fftBounds;
+    {
+        const juce::SpinLock::ScopedLockType sl(analysisBoundsLock);
+        fftBounds = analysisBounds;
+    }
+    
+    if( fftBounds.isEmpty() )
+        return;
+    
+    auto sampleRate = audioProcessor.getSampleRate();
+    
+    //пути строятся прямо в буфере записи, кадр публикуется обменом индексов, без копий
+    auto& frame = analyzerFrames.getWriteBuffer();
+    if( pathProducer.process(frame.leftPath, frame.rightPath, fftBounds, sampleRate, recordPicsEnable) )
+    {
+        frame.timings = pathProducer.getTimings();
+        frame.coherence = pathProducer.getCoherence();
+        analyzerFrames.publish();
+    }
+}
+
+bool ResponseCurveComponent::isOnScreen()
+{
+    if( ! isShowing() )
+        return false;
+    
+    //isShowing смотрит только на флаги компонентов; свернутое или полностью перекрытое окно знает лишь его peer
+    auto* peer = getPeer();
+    return peer != nullptr && ! peer->isMinimised() && peer->isShowing();
+}
 
-    auto peakCoefficients = makePeakFilter(chainSettings, audioProcessor.getSampleRate());
-    updateCoefficients(monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+void ResponseCurveComponent::timerCallback()
+{
+    //свернутый, скрытый или закрытый другими окнами редактор ничего не считает и не рисует,
+    //таймер только редко проверяет, не показали ли его снова
+    if( ! isOnScreen() )
+    {
+        if( ! analyzerIdle )
+        {
+            analyzerIdle = true;
+            startTimerHz(idleTimerHz);
+        }
+        
+        return;
+    }
+    
+    if( analyzerIdle )
+    {
+        //пока поток спал, кольца копили звук, которого уже нет
+        pathProducer.discardPendingSamples();
+        analyzerIdle = false;
+        analyzerThread.notify();
+        startTimerHz(framesPerSecond);
+    }
+    
+    //интерфейс только забирает готовый кадр, вся работа в фоновом потоке.
+    //перерисовываем только то, что изменилось
+    if( analyzerFrames.pull() )
+    {
+        auto& frame = analyzerFrames.getReadBuffer();
+        leftChannelFFTPath.swapWithPath(frame.leftPath);
+        rightChannelFFTPath.swapWithPath(frame.rightPath);
+        analyzerTimings = frame.timings;
+        analyzerCoherence.swap(frame.coherence);
+        
+        if( shouldShowFFTAnalysis )
+            repaint(getAnalysisArea());
+    }
+    
 
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, audioProcessor.getSampleRate());
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, audioProcessor.getSampleRate());
+    auto curveMayHaveChanged = pullChainSnapshot();
+    
+    if( parametersChanged.compareAndSetBool(false, true) )
+    {
+        updateAnalyzerResolution();
+        curveMayHaveChanged = true;
+    }
+    
+    if( curveMayHaveChanged && updateCurveCoefficients() )
+    {
+        updateResponseCurve();
+        repaint(getRenderArea());
+    }
+    
+    updateFrameRate();
+}
 
-    updateCutFilter(monoChain.get<ChainPositions::LowCut>(),
-        lowCutCoefficients,
-        chainSettings.lowCutSlope);
+void ResponseCurveComponent::updateFrameRate()
+{
+    //рисование должно занимать не больше четверти кадра, иначе снижаем частоту
+    const auto affordable = averagePaintMs > 0.0 ? (int)(250.0 / averagePaintMs) : maxFramesPerSecond;
+    const auto newFramesPerSecond = juce::jlimit(minFramesPerSecond, maxFramesPerSecond, affordable);
+    
+    //небольшие колебания не трогают таймер
+    if( std::abs(newFramesPerSecond - framesPerSecond.load()) >= 5 )
+    {
+        framesPerSecond = newFramesPerSecond;
+        startTimerHz(newFramesPerSecond);
+    }
+}
 
-    updateCutFilter(monoChain.get<ChainPositions::HighCut>(),
-        highCutCoefficients,
-        chainSettings.highCutSlope);
+void ResponseCurveComponent::updateAnalyzerResolution()
+{
+    auto resolution = (int)audioProcessor.apvts.getRawParameterValue("Analyzer Resolution")->load();
+    pathProducer.setResolution(static_cast<AnalyzerResolution>(resolution));
 }
 
-void ResponseCurveComponent::updateChain()
+bool ResponseCurveComponent::pullChainSnapshot()
 {
-    auto chainSettings = getChainSettings(audioProcessor.apvts);
+    const auto version = audioProcessor.getChainSnapshotVersion();
     
-    monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    monoChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    monoChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    if( chainSnapshot != nullptr && chainSnapshot->version == version )
+        return false;
     
-    auto peakCoefficients = makePeakFilter(chainSettings, audioProcessor.getSampleRate());
-    updateCoefficients(monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    chainSnapshot = audioProcessor.getChainSnapshot();
+    return chainSnapshot != nullptr;
+}
+
+bool ResponseCurveComponent::updateCurveCoefficients()
+{
+    const auto processorSampleRate = audioProcessor.getSampleRate();
     
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, audioProcessor.getSampleRate());
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, audioProcessor.getSampleRate());
+    //обычно рисуем ровно то, что звучит. пока крутят ручку или строится ядро, снимок отстает от APVTS,
+    //но второй расчет здесь показал бы коэффициенты, которых еще нет в звуке - ждем следующий снимок
+    if( chainSnapshot != nullptr && processorSampleRate > 0 )
+    {
+        const auto& coefficients = chainSnapshot->coefficients;
+        if( coefficients.settings == curveCoefficients.settings && coefficients.sampleRate == curveCoefficients.sampleRate )
+            return false;
+        
+        curveCoefficients = coefficients;
+        return true;
+    }
+    
+    //снимка нет или процессор еще не подготовлен, и поток расчета ничего не опубликует:
+    //тогда считаем по APVTS сами, как раньше
+    const auto settings = getChainSettings(audioProcessor.apvts);
+    auto sampleRate = processorSampleRate;
+    if( sampleRate <= 0 )
+        sampleRate = chainSnapshot != nullptr ? chainSnapshot->coefficients.sampleRate : 48000.0;
     
-    updateCutFilter(monoChain.get<ChainPositions::LowCut>(),
-                    lowCutCoefficients,
-                    chainSettings.lowCutSlope);
+    if( settings == curveCoefficients.settings && sampleRate == curveCoefficients.sampleRate )
+        return false;
     
-    updateCutFilter(monoChain.get<ChainPositions::HighCut>(),
-                    highCutCoefficients,
-                    chainSettings.highCutSlope);
+    curveCoefficients = makeChainCoefficients(settings, sampleRate);
+    return true;
 }
 
 juce::Rectangle<int> ResponseCurveComponent::getRenderArea()
@@ -683,7 +1039,8 @@ lowcutBypassButtonAttachment(audioProcessor.apvts, "LowCut Bypassed", lowcutBypa
 peakBypassButtonAttachment(audioProcessor.apvts, "Peak Bypassed", peakBypassButton),
 highcutBypassButtonAttachment(audioProcessor.apvts, "HighCut Bypassed", highcutBypassButton),
 analyzerEnabledButtonAttachment(audioProcessor.apvts, "Analyzer Enabled", analyzerEnabledButton),
-autoEnabledButtonAttachment(audioProcessor.apvts, "Auto Enabled", autoEnabledButton)
+autoEnabledButtonAttachment(audioProcessor.apvts, "Auto Enabled", autoEnabledButton),
+linearPhaseButtonAttachment(audioProcessor.apvts, "Linear Phase", linearPhaseButton)
 {
     peakFreqSlider.labels.add({0.f, "20Hz"});
     peakFreqSlider.labels.add({1.f, "20kHz"});
@@ -706,11 +1063,17 @@ autoEnabledButtonAttachment(audioProcessor.apvts, "Auto Enabled", autoEnabledBut
     highCutSlopeSlider.labels.add({0.0f, "12"});
     highCutSlopeSlider.labels.add({1.f, "48"});
     
+    analyzerResolutionBox.addItemList({ "Low CPU", "Standard", "Fine", "High Res" }, 1);
+    analyzerResolutionBoxAttachment = std::make_unique<APVTS::ComboBoxAttachment>(audioProcessor.apvts, "Analyzer Resolution", analyzerResolutionBox);
+    
     for( auto* comp : getComps() )
     {
         addAndMakeVisible(comp);
     }
     
+    //виден только пока идет подбор фильтров
+    addChildComponent(autoEQProgressBar);
+    
     peakBypassButton.setLookAndFeel(&lnf);
     highcutBypassButton.setLookAndFeel(&lnf);
     lowcutBypassButton.setLookAndFeel(&lnf);
@@ -770,31 +1133,9 @@ autoEnabledButtonAttachment(audioProcessor.apvts, "Auto Enabled", autoEnabledBut
             auto enabled = comp->autoEnabledButton.getToggleState();
             comp->responseCurveComponent.toggleAutoEnablement(!enabled);
             
-            if (enabled == true) { 
-                auto sampleRate = comp->responseCurveComponent.getSamplerate();
-                auto settings = comp->responseCurveComponent.getSettings();
-                settings = comp->responseCurveComponent.getNewFilters(settings);
-                
-                comp->lowCutFreqSlider.setValue(settings.lowCutFreq);
-                comp->highCutFreqSlider.setValue(settings.highCutFreq);
-                comp->peakFreqSlider.setValue(settings.peakFreq);
-                comp->peakQualitySlider.setValue(settings.peakQuality);
-                comp->peakGainSlider.setValue(settings.peakGainInDecibels);
-                if (settings.highCutSlope == Slope_12) { comp->highCutSlopeSlider.setValue(0); }
-                if (settings.highCutSlope == Slope_24) { comp->highCutSlopeSlider.setValue(1); }
-                if (settings.highCutSlope == Slope_36) { comp->highCutSlopeSlider.setValue(2); }
-                if (settings.highCutSlope == Slope_48) { comp->highCutSlopeSlider.setValue(3); }
-                if (settings.lowCutSlope == Slope_12) { comp->highCutSlopeSlider.setValue(0); }
-                if (settings.lowCutSlope == Slope_24) { comp->highCutSlopeSlider.setValue(1); }
-                if (settings.lowCutSlope == Slope_36) { comp->highCutSlopeSlider.setValue(2); }
-                if (settings.lowCutSlope == Slope_48) { comp->highCutSlopeSlider.setValue(3); }
-                comp->lowcutBypassButton.setToggleState(settings.lowCutBypassed, true);
-                comp->peakBypassButton.setToggleState(settings.peakBypassed, true);
-                comp->highcutBypassButton.setToggleState(settings.highCutBypassed, true);
-
-                comp->responseCurveComponent.updateChain(settings);
-                comp->responseCurveComponent.updateResponseCurve();
-            }
+            //новая запись отменяет подбор по старой
+            if (enabled == true) { comp->startAutoEQ(); }
+            else { comp->cancelAutoEQ(); }
         }
     };
     
@@ -803,6 +1144,10 @@ autoEnabledButtonAttachment(audioProcessor.apvts, "Auto Enabled", autoEnabledBut
 
 SimpleEQAudioProcessorEditor::~SimpleEQAudioProcessorEditor()
 {
+    //задача пишет только в свой прогресс, но дожидаемся ее, пока члены редактора еще живы
+    stopTimer();
+    autoEQPool.removeAllJobs(true, -1);
+    
     peakBypassButton.setLookAndFeel(nullptr);
     highcutBypassButton.setLookAndFeel(nullptr);
     lowcutBypassButton.setLookAndFeel(nullptr);
@@ -813,6 +1158,12 @@ SimpleEQAudioProcessorEditor::~SimpleEQAudioProcessorEditor()
 
 //==============================================================================
 void SimpleEQAudioProcessorEditor::paint(juce::Graphics &g)
+{
+    //все, что рисует редактор, меняется только в resized()
+    backgroundLayer.draw(g, getLocalBounds(), [this](juce::Graphics& layer) { drawBackground(layer); });
+}
+
+void SimpleEQAudioProcessorEditor::drawBackground(juce::Graphics &g)
 {
     using namespace juce;
     
@@ -866,6 +1217,8 @@ void SimpleEQAudioProcessorEditor::paint(juce::Graphics &g)
 
 void SimpleEQAudioProcessorEditor::resized()
 {
+    backgroundLayer.invalidate();
+    
     auto bounds = getLocalBounds();
     bounds.removeFromTop(4);
     
@@ -885,6 +1238,10 @@ void SimpleEQAudioProcessorEditor::resized()
     autoEnabledArea.removeFromTop(2);
     
     autoEnabledButton.setBounds(autoEnabledArea.removeFromTop(25));
+    
+    autoEQProgressBar.setBounds(90, 8, 100, 19);
+    linearPhaseButton.setBounds(getWidth() - 115, 6, 110, 23);
+    analyzerResolutionBox.setBounds(getWidth() - 200, 6, 80, 23);
 
     bounds.removeFromTop(5);
     
@@ -912,6 +1269,70 @@ void SimpleEQAudioProcessorEditor::resized()
     peakQualitySlider.setBounds(bounds);
 }
 
+void SimpleEQAudioProcessorEditor::startAutoEQ()
+{
+    cancelAutoEQ();
+    
+    std::vector<float> spectrum;
+    float binWidth = 0;
+    if( ! responseCurveComponent.takeCapturedSpectrum(spectrum, binWidth) )
+        return;
+    
+    const auto run = autoEQRun;
+    juce::Component::SafePointer<SimpleEQAudioProcessorEditor> safePtr(this);
+    
+    autoEQJobProgress = std::make_shared<std::atomic<double>>(0.0);
+    autoEQProgress = 0;
+    autoEQProgressBar.setVisible(true);
+    startTimerHz(30);
+    
+    autoEQPool.addJob(new AutoEQJob(std::move(spectrum), binWidth, responseCurveComponent.getSettings(), autoEQJobProgress,
+                                    [safePtr, run](const ChainSettings& settings)
+                                    {
+                                        if( auto* comp = safePtr.getComponent() )
+                                        {
+                                            if( comp->autoEQRun == run )
+                                                comp->applyAutoEQSettings(settings);
+                                        }
+                                    }),
+                      true);
+}
+
+void SimpleEQAudioProcessorEditor::cancelAutoEQ()
+{
+    //не ждем: отмененная задача сама выйдет на ближайшей проверке, а ее результат отсечет номер запуска
+    //прогресс старой задачи остается у нее, полоса его больше не видит
+    ++autoEQRun;
+    autoEQPool.removeAllJobs(true, 0);
+    stopTimer();
+    autoEQJobProgress.reset();
+    autoEQProgressBar.setVisible(false);
+}
+
+void SimpleEQAudioProcessorEditor::timerCallback()
+{
+    if( autoEQJobProgress != nullptr )
+        autoEQProgress = autoEQJobProgress->load();
+}
+
+void SimpleEQAudioProcessorEditor::applyAutoEQSettings(const ChainSettings& settings)
+{
+    stopTimer();
+    autoEQJobProgress.reset();
+    autoEQProgressBar.setVisible(false);
+    
+    lowCutFreqSlider.setValue(settings.lowCutFreq);
+    highCutFreqSlider.setValue(settings.highCutFreq);
+    peakFreqSlider.setValue(settings.peakFreq);
+    peakQualitySlider.setValue(settings.peakQuality);
+    peakGainSlider.setValue(settings.peakGainInDecibels);
+    highCutSlopeSlider.setValue(settings.highCutSlope);
+    lowCutSlopeSlider.setValue(settings.lowCutSlope);
+    lowcutBypassButton.setToggleState(settings.lowCutBypassed, true);
+    peakBypassButton.setToggleState(settings.peakBypassed, true);
+    highcutBypassButton.setToggleState(settings.highCutBypassed, true);
+}
+
 std::vector<juce::Component*> SimpleEQAudioProcessorEditor::getComps()
 {
     return
@@ -929,6 +1350,8 @@ std::vector<juce::Component*> SimpleEQAudioProcessorEditor::getComps()
         &peakBypassButton,
         &highcutBypassButton,
         &analyzerEnabledButton,
-        &autoEnabledButton
+        &autoEnabledButton,
+        &linearPhaseButton,
+        &analyzerResolutionBox
     };
 }
@@ -10,6 +10,28 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "DecibelKernel.h"
+#include "ResponseEvaluator.h"
+
+/**
+ сколько занял каждый этап анализа на последнем проходе фонового потока, в миллисекундах.
+ */
+struct AnalyzerTimings
+{
+    double drainMs = 0;     //чтение из кольца и сдвиг окна
+    double fftMs = 0;       //окно, FFT и перевод в дБ
+    double pathMs = 0;      //построение juce::Path и сбор данных для авто-эквалайзера
+    int numFFTFrames = 0;
+    
+    AnalyzerTimings& operator+=(const AnalyzerTimings& other)
+    {
+        drainMs += other.drainMs;
+        fftMs += other.fftMs;
+        pathMs += other.pathMs;
+        numFFTFrames += other.numFFTFrames;
+        return *this;
+    }
+};
 
 enum FFTOrder
 {
@@ -18,105 +40,231 @@ enum FFTOrder
     order8192 = 13
 };
 
+static constexpr int numFFTOrders = order8192 - order2048 + 1;
+
+/**
+ какой спектр лежит в каком участке данных FFTDataGenerator, по numBins значений в каждом.
+ left, right, mid и side в дБ, coherence - когерентность каналов от 0 до 1.
+ */
+enum class StereoSpectrum
+{
+    left,
+    right,
+    mid,
+    side,
+    coherence,
+    numSpectra
+};
+
+/**
+ как раскрасить две линии анализатора: левый и правый каналы или mid/side.
+ */
+enum class StereoAnalysisMode
+{
+    leftRight,
+    midSide
+};
+
 template<typename BlockType>
 struct FFTDataGenerator
 {
     /**
-     генерирует данные БПФ из звукового буфера.
+     генерирует данные БПФ из двухканального буфера одним комплексным преобразованием:
+     левый канал идет в действительную часть, правый в мнимую, а спектры разделяются
+     по сопряженной симметрии: L[k] = (X[k] + X*[N-k]) / 2, R[k] = (X[k] - X*[N-k]) / 2i.
      */
     void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
     {
         const auto fftSize = getFFTSize();
+        const auto numBins = fftSize / 2;
+        auto& plan = getPlan();
         
-        fftData.assign(fftData.size(), 0);
-        auto* readIndex = audioData.getReadPointer(0);
-        std::copy(readIndex, readIndex + fftSize, fftData.begin());
+        //буфер может быть длиннее окна: берем последние fftSize сэмплов
+        jassert(audioData.getNumSamples() >= fftSize);
+        const auto offset = audioData.getNumSamples() - fftSize;
+        auto* left = audioData.getReadPointer(0) + offset;
+        auto* right = audioData.getReadPointer(juce::jmin(1, audioData.getNumChannels() - 1)) + offset;
+        auto* windowTable = plan.windowTable.data();
         
         // сначала примените оконную функцию к нашим данным
-        window->multiplyWithWindowingTable (fftData.data(), fftSize);       // [1]
+        for( int i = 0; i < fftSize; ++i )
+            timeData[(size_t)i] = { left[i] * windowTable[i], right[i] * windowTable[i] };
         
-        // затем визуализируем наши данные fft..
-        forwardFFT->performFrequencyOnlyForwardTransform (fftData.data());  // [2]
+        plan.fft->perform(timeData.data(), spectrum.data(), false);
         
-        int numBins = (int)fftSize / 2;
+        auto* leftData = getSpectrum(StereoSpectrum::left);
+        auto* rightData = getSpectrum(StereoSpectrum::right);
+        auto* midData = getSpectrum(StereoSpectrum::mid);
+        auto* sideData = getSpectrum(StereoSpectrum::side);
+        auto* coherenceData = getSpectrum(StereoSpectrum::coherence);
         
-        
-        //нормализуйте значения fft.
-        for( int i = 0; i < numBins; ++i )
+        //сначала в участки left..side кладем мощность |X|^2: корень не нужен, 20 lg|X| = 10 lg|X|^2
+        for( int k = 0; k < numBins; ++k )
         {
-            auto v = fftData[i];
-//            fftData[i] /= (float) numBins;
-            if( !std::isinf(v) && !std::isnan(v) )
-            {
-                v /= float(numBins);
-            }
-            else
-            {
-                v = 0.f;
-            }
-            fftData[i] = v;
+            const auto x = spectrum[(size_t)k];
+            const auto y = std::conj(spectrum[(size_t)((fftSize - k) & (fftSize - 1))]);
+            
+            const auto l = (x + y) * 0.5f;
+            const auto r = (x - y) * std::complex<float>(0.f, -0.5f);
             
+            leftData[k] = std::norm(l);
+            rightData[k] = std::norm(r);
+            midData[k] = std::norm((l + r) * 0.5f);
+            sideData[k] = std::norm((l - r) * 0.5f);
+            
+            //когерентности нужны усредненные по кадрам авто- и взаимный спектры
+            auto& s = crossSpectra[(size_t)k];
+            s.leftPower = coherenceSmoothing * s.leftPower + (1.f - coherenceSmoothing) * std::norm(l);
+            s.rightPower = coherenceSmoothing * s.rightPower + (1.f - coherenceSmoothing) * std::norm(r);
+            s.cross = coherenceSmoothing * s.cross + (1.f - coherenceSmoothing) * l * std::conj(r);
+            
+            const auto denominator = s.leftPower * s.rightPower;
+            coherenceData[k] = denominator > 1e-30f ? juce::jmin(1.f, std::norm(s.cross) / denominator) : 0.f;
         }
         
-        //преобразуйте их в децибелы
-        for( int i = 0; i < numBins; ++i )
+        //затем одним проходом по четырем участкам подряд: нормализация на numBins, отсев NaN/Inf и дБ
+        const auto normalisation = 1.f / float(numBins);
+        powerToDecibels(leftData, leftData, (int)StereoSpectrum::coherence * numBins, normalisation * normalisation, negativeInfinity);
+        
+        fftDataFrames.publish();
+    }
+    
+    /**
+     строит FFT и окна сразу для всех порядков, а буферы выделяет под самый большой.
+     после этого changeOrder ничего не выделяет и может вызываться прямо во время анализа.
+     */
+    void prepare()
+    {
+        for( int i = 0; i < numFFTOrders; ++i )
         {
-            fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
+            auto& plan = plans[(size_t)i];
+            const auto fftSize = 1 << (order2048 + i);
+            
+            plan.fft = std::make_unique<juce::dsp::FFT>(order2048 + i);
+            plan.windowTable.assign((size_t)fftSize, 1.f);
+            juce::dsp::WindowingFunction<float>::fillWindowingTables(plan.windowTable.data(), (size_t)fftSize,
+                                                                    juce::dsp::WindowingFunction<float>::blackmanHarris);
         }
         
-        fftDataFifo.push(fftData);
+        const auto maxFFTSize = getMaxFFTSize();
+        
+        timeData.assign((size_t)maxFFTSize, {});
+        spectrum.assign((size_t)maxFFTSize, {});
+        crossSpectra.assign((size_t)maxFFTSize / 2, {});
+        
+        const auto dataSize = (size_t)(maxFFTSize / 2 * (int)StereoSpectrum::numSpectra);
+        fftDataFrames.prepareBuffers([dataSize](BlockType& frame) { frame.assign(dataSize, 0); });
+        
+        changeOrder(order);
     }
     
     void changeOrder(FFTOrder newOrder)
     {
-        //когда вы меняете порядок, заново открываете окно, пересылаете FFT, fifo, fftData
-        //также сбросьте fifoIndex
-        //вещи, которые нуждаются в воссоздании, должны быть созданы в куче с помощью std::make_unique<>
-        
+        //все уже выделено в prepare: переключаем план и забываем когерентность, посчитанную на других бинах
         order = newOrder;
-        auto fftSize = getFFTSize();
-        
-        forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-        window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
-        
-        fftData.clear();
-        fftData.resize(fftSize * 2, 0);
-
-        fftDataFifo.prepare(fftData.size());
+        std::fill(crossSpectra.begin(), crossSpectra.end(), CrossSpectrum());
     }
     //==============================================================================
+    static int getMaxFFTSize() { return 1 << order8192; }
+    FFTOrder getOrder() const { return order; }
     int getFFTSize() const { return 1 << order; }
-    int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
+    int getNumBins() const { return getFFTSize() / 2; }
+    int getDataSize() const { return getNumBins() * (int)StereoSpectrum::numSpectra; }
     //==============================================================================
-    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
+    //забирает самый свежий кадр, если он есть; сами данные не копируются
+    bool pullFFTData() { return fftDataFrames.pull(); }
+    const BlockType& getFFTData() const { return fftDataFrames.getReadBuffer(); }
+    
+    //кадры, которые перезаписали раньше, чем их забрали
+    juce::uint64 getNumDroppedFrames() const { return fftDataFrames.getNumDroppedFrames(); }
 private:
-    FFTOrder order;
-    BlockType fftData;
-    std::unique_ptr<juce::dsp::FFT> forwardFFT;
-    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    float* getSpectrum(StereoSpectrum s) { return fftDataFrames.getWriteBuffer().data() + (int)s * getNumBins(); }
+    
+    struct Plan
+    {
+        std::unique_ptr<juce::dsp::FFT> fft;
+        std::vector<float> windowTable;
+    };
     
-    Fifo<BlockType> fftDataFifo;
+    Plan& getPlan() { return plans[(size_t)(order - order2048)]; }
+    
+    struct CrossSpectrum
+    {
+        float leftPower = 0, rightPower = 0;
+        std::complex<float> cross;
+    };
+    
+    //~0.15 с памяти при 60 кадрах в секунду
+    static constexpr float coherenceSmoothing = 0.9f;
+    
+    FFTOrder order = order2048;
+    std::array<Plan, numFFTOrders> plans;
+    std::vector<std::complex<float>> timeData, spectrum;
+    std::vector<CrossSpectrum> crossSpectra;
+    
+    TripleBuffer<BlockType> fftDataFrames;
 };
 
-struct FFTSample
+/**
+ накопитель спектров для авто-эквалайзера: среднее и дисперсия по каждому бину считаются
+ на лету по Уэлфорду, кадры не хранятся. память O(бинов) при любой длине записи,
+ а среднее готово в любой момент.
+ */
+struct SpectrumAccumulator
 {
-    FFTSample(std::vector<float> retorDtata) {
-        this->retorDtata = retorDtata;
+    //память под самый большой кадр выделяется заранее, чтобы add не выделял ее в потоке анализатора
+    void prepare(int maxNumValues)
+    {
+        mean.reserve((size_t)maxNumValues);
+        m2.reserve((size_t)maxNumValues);
+    }
+
+    void reset()
+    {
+        mean.clear();
+        m2.clear();
+        count = 0;
     }
 
-    float getY(int iter) { return retorDtata[iter]; }
-    std::vector<float> getData() { return retorDtata; }
+    void add(const std::vector<float>& values)
+    {
+        //первый кадр задает число бинов, смена размера FFT сбрасывает накопление
+        if( count == 0 )
+        {
+            mean.assign(values.size(), 0.f);
+            m2.assign(values.size(), 0.f);
+        }
+
+        jassert(values.size() == mean.size());
+
+        ++count;
+        const auto weight = 1.f / (float)count;
+
+        for( size_t i = 0; i < mean.size(); ++i )
+        {
+            const auto delta = values[i] - mean[i];
+            mean[i] += delta * weight;
+            m2[i] += delta * (values[i] - mean[i]);
+        }
+    }
+
+    int getCount() const { return count; }
+    const std::vector<float>& getMean() const { return mean; }
+    float getVariance(int bin) const { return count > 1 ? m2[(size_t)bin] / (float)(count - 1) : 0.f; }
 private:
-    std::vector<float> retorDtata;
+    std::vector<float> mean, m2;
+    int count = 0;
 };
 
 template<typename PathType>
 struct AnalyzerPathGenerator
 {
     /*
-     converts 'renderData[]' into a juce::Path
+     converts 'renderData[]' into a juce::Path.
+     путь перезаписывается на месте: после первых кадров его память больше не выделяется
      */
-    void generatePath(const std::vector<float>& renderData,
+    void generatePath(PathType& p,
+                      const float* renderData,
                       juce::Rectangle<float> fftBounds,
                       int fftSize,
                       float binWidth,
@@ -127,8 +275,7 @@ struct AnalyzerPathGenerator
         auto width = fftBounds.getWidth();
         int numBins = (int)fftSize / 2;
 
-        PathType p;
-        p.preallocateSpace(3 * (int)fftBounds.getWidth());
+        p.clear();
 
         auto map = [bottom, top, negativeInfinity](float v)
         {
@@ -145,30 +292,63 @@ struct AnalyzerPathGenerator
         
         p.startNewSubPath(0, y);
 
-        const int pathResolution = 1; //вы можете провести линию к каждому пикселю "Разрешения пути".
-        
+        updateColumnMap(numBins, binWidth, width);
 
-        for( int binNum = 1; binNum < numBins; binNum += pathResolution )
+        //startNewSubPath и до двух lineTo на столбец, по 3 float на каждый.
+        //столбцов чуть больше ширины: бины ниже 20 Гц и выше 20 кГц выходят за края
+        p.preallocateSpace(6 * numMappedColumns + 3);
+
+        //бины одного столбца пикселей сводятся к паре минимум/максимум,
+        //поэтому размер пути зависит от ширины, а не от размера FFT
+        struct Column
         {
-            y = map(renderData[binNum]);
+            int x = 0;
+            float lowest = 0, highest = 0;
+            bool lowestFirst = true;
+        };
 
-//            jassert( !std::isnan(y) && !std::isinf(y) );
+        auto emitColumn = [&p, &map](const Column& c)
+        {
+            //порядок экстремумов тот же, что и в данных, чтобы линия не перекрещивалась
+            p.lineTo((float)c.x, map(c.lowestFirst ? c.lowest : c.highest));
 
-            if( !std::isnan(y) && !std::isinf(y) )
+            if( c.lowest != c.highest )
+                p.lineTo((float)c.x, map(c.lowestFirst ? c.highest : c.lowest));
+        };
+
+        if( numBins > 1 )
+        {
+            Column column { binColumns[1], renderData[1], renderData[1], true };
+
+            for( int binNum = 2; binNum < numBins; ++binNum )
             {
-                auto binFreq = binNum * binWidth;
-                auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
-                int binX = std::floor(normalizedBinX * width);
-                p.lineTo(binX, y);
+                const auto v = renderData[binNum];
+
+                if( binColumns[(size_t)binNum] != column.x )
+                {
+                    emitColumn(column);
+                    column = { binColumns[(size_t)binNum], v, v, true };
+                }
+                else if( v < column.lowest )
+                {
+                    column.lowest = v;
+                    column.lowestFirst = false;
+                }
+                else if( v > column.highest )
+                {
+                    column.highest = v;
+                    column.lowestFirst = true;
+                }
             }
+
+            emitColumn(column);
         }
 
         //тут можно подрезать финальные значения ачх
-
-        pathFifo.push(p);
     }
 
-    FFTSample analize(const std::vector<float>& renderData,
+    //кадр для авто-эквалайзера: бины без нулевого, отображенные в 0..1000. буфер переиспользуется
+    const std::vector<float>& analize(const float* renderData,
         int fftSize,
         float binWidth,
         float negativeInfinity)
@@ -192,30 +372,50 @@ struct AnalyzerPathGenerator
         if (std::isnan(y) || std::isinf(y))
             y = bottom;
 
-        std::vector<float> returnSamle;
+        analysisFrame.resize((size_t)juce::jmax(0, numBins - 1));
 
         for (int binNum = 1; binNum < numBins; binNum += 1)
         {
             y = map(renderData[binNum]);
-            returnSamle.push_back(y);
+            analysisFrame[(size_t)binNum - 1] = y;
         }
 
-        return FFTSample(returnSamle);
+        return analysisFrame;
     }
 
-    int getNumPathsAvailable() const
+    /**
+     столбец пикселя для каждого бина. считается заново, только когда меняется
+     ширина области, частота дискретизации или размер FFT.
+     */
+    void updateColumnMap(int numBins, float binWidth, float width)
     {
-        return pathFifo.getNumAvailableForReading();
-    }
+        if( numBins == mappedNumBins && binWidth == mappedBinWidth && width == mappedWidth )
+            return;
 
-    bool getPath(PathType& path)
-    {
-        return pathFifo.pull(path);
-    }
+        mappedNumBins = numBins;
+        mappedBinWidth = binWidth;
+        mappedWidth = width;
+
+        binColumns.resize((size_t)numBins);
+        numMappedColumns = 0;
 
+        //нулевой бин рисуется отдельно, в x = 0
+        for( int binNum = 1; binNum < numBins; ++binNum )
+        {
+            auto normalizedBinX = juce::mapFromLog10(binNum * binWidth, 20.f, 20000.f);
+            binColumns[(size_t)binNum] = (int)std::floor(normalizedBinX * width);
+
+            //столбцы растут вместе с частотой, поэтому новый столбец - это смена значения
+            if( binNum == 1 || binColumns[(size_t)binNum] != binColumns[(size_t)binNum - 1] )
+                ++numMappedColumns;
+        }
+    }
 
 private:
-    Fifo<PathType> pathFifo;
+    std::vector<int> binColumns;
+    std::vector<float> analysisFrame;
+    int mappedNumBins = 0, numMappedColumns = 0;
+    float mappedBinWidth = 0, mappedWidth = 0;
 };
 
 struct LookAndFeel : juce::LookAndFeel_V4
@@ -270,178 +470,183 @@ private:
 
 
 
+/**
+ анализатор обоих каналов: одно комплексное FFT на кадр дает спектры L, R, mid, side и когерентность.
+ */
 struct PathProducer
 {
-    PathProducer(SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>& scsf) :
-    leftChannelFifo(&scsf)
+    PathProducer(SingleChannelSampleFifo& left, SingleChannelSampleFifo& right) :
+    leftChannelFifo(&left),
+    rightChannelFifo(&right)
     {
-        leftChannelFFTDataGenerator.changeOrder(FFTOrder::order2048);
-        monoBuffer.setSize(1, leftChannelFFTDataGenerator.getFFTSize());
+        fftDataGenerator.prepare();
+        //окна держат историю под самый большой FFT, поэтому смена разрешения не ждет, пока они наполнятся
+        windowBuffer.setSize(2, fftDataGenerator.getMaxFFTSize());
+        windowBuffer.clear();
+        coherence.reserve((size_t)fftDataGenerator.getMaxFFTSize() / 2);
+        retorDtata.prepare(fftDataGenerator.getMaxFFTSize() / 2);
     }
-    void process(juce::Rectangle<float> fftBounds, double sampleRate, bool autoON);
-    juce::Path getPath() { return leftChannelFFTPath; }
-    std::list<FFTSample> getFFTSample() { return retorDtata; }
-    void pushFFTSamle(FFTSample sample) { 
-        retorDtata.push_back(sample);
-        if (retorDtata.size() > 4000)
-        {
-            retorDtata.pop_front();
-        }
-         
-        
+    /**
+     забирает новые сэмплы и, если пора, считает кадр и строит пути прямо в leftPath и rightPath.
+     возвращает false, если пути не менялись: тогда в них могут лежать старые данные.
+     */
+    bool process(juce::Path& leftPath, juce::Path& rightPath, juce::Rectangle<float> fftBounds, double sampleRate, bool autoON);
+    const AnalyzerTimings& getTimings() const { return timings; }
+    
+    //что показывают две линии анализатора
+    void setStereoAnalysisMode(StereoAnalysisMode newMode) { stereoAnalysisMode = newMode; }
+    
+    //размер FFT и частота кадров; новый порядок применяется в фоновом потоке на следующем проходе
+    void setResolution(AnalyzerResolution resolution);
+    
+    //последний кадр когерентности каналов по бинам, от 0 до 1.
+    //переписывается в process(), поэтому читать только из потока анализатора; интерфейсу она приходит с кадром
+    const std::vector<float>& getCoherence() const { return coherence; }
+    
+    /**
+     когда считать новый кадр FFT, независимо от размера блока хоста:
+     либо по перекрытию соседних окон (0.5, 0.75), либо по желаемому числу кадров в секунду.
+     заданный так шаг важнее частоты кадров из setResolution, пресет разрешения его не сбрасывает.
+     */
+    void setOverlap(float newOverlap) { overlap = juce::jlimit(0.f, 0.875f, newOverlap); framesPerSecond = 0.0; hopConfigured = true; }
+    //0 - по перекрытию
+    void setFramesPerSecond(double newFramesPerSecond) { framesPerSecond = juce::jmax(0.0, newFramesPerSecond); hopConfigured = true; }
+    int getHopSize(double sampleRate) const;
+    
+    /**
+     выбросить накопленные в кольцах сэмплы и историю окна, когда анализ возобновляется
+     после простоя: иначе первый кадр покажет давно прозвучавший звук.
+     сами кольца читает только поток анализатора, поэтому здесь лишь ставится флаг для process().
+     */
+    void discardPendingSamples() { discardRequested = true; }
+    //сколько кадров накоплено для авто-эквалайзера
+    int getNumCapturedFrames() { const juce::ScopedLock sl(retorDataLock); return retorDtata.getCount(); }
+    void pushFFTSamle(const std::vector<float>& sample, float binWidth) { 
+        const juce::ScopedLock sl(retorDataLock);
+        retorBinWidth = binWidth;
+        retorDtata.add(sample);
     }
 
     void cleerRetorData() {
-        retorDtata.clear();
+        const juce::ScopedLock sl(retorDataLock);
+        retorDtata.reset();
     }
     
-    ChainSettings generateNewFilters(ChainSettings cainSettings) {
-        if (retorDtata.size() == 0) { return cainSettings; }
-        std::vector<float> summData = retorDtata.begin()->getData();
-        int size = retorDtata.size();
-        retorDtata.pop_front();
-
-        float binWidth = 23.4375;
-
-
-        for (auto i = retorDtata.begin(); i != retorDtata.end(); i++)
-        {
-            for (int j = 0; j < summData.size(); j++)
-            {
-                summData[j] += i->getY(j);
-            }
-        }
-        for (int j = 0; j < summData.size(); j++)
-        {
-            summData[j] = summData[j]/size;
-        }
-        // получили среднее значение для каждой полученной чистоты
-        retorDtata.clear();
-
-        int lowpick = 0;
-        int higtpick = size - 1;
-        float higtMax = 0;
-        float lowMax = summData[0];
-        if (lowMax == 0) { return cainSettings; }
-        for (int i = 1; lowMax <= summData[i]; i++)
-        {
-            lowMax = summData[i];
-            lowpick = i;
-        }
-        for (int i = size - 1; summData[i] == 0 && i > 0; i--)
-        {
-            higtpick = i - 1;
-        }
-        std::vector<int> firstHihtPics;
-        firstHihtPics.push_back(higtpick);
-        higtMax = summData[higtpick];
-
-
-        float rangeHigtSorce = 0.1;
-        auto tmpnormalizedRange = juce::mapFromLog10(higtpick*binWidth, 20.f, 20000.f);
-        int numOfIterSerch = 5;
-        for (int i = 0; i < numOfIterSerch && tmpnormalizedRange > 0.5; i++)
-        {
-            tmpnormalizedRange = tmpnormalizedRange - rangeHigtSorce;
-            higtpick = std::floor(juce::mapToLog10(tmpnormalizedRange, 20.f, 20000.f)/ binWidth);
-
-            for (int j = higtpick; j <= firstHihtPics.back(); j++)
-            {
-                if (summData[j] >= higtMax)
-                {
-                    higtMax = summData[j];
-                    higtpick = j;
-                }
-             
-            }
-            if (higtpick == firstHihtPics.back())
-            {
-                rangeHigtSorce += 0.1;
-                i--;
-            }
-            else
-            {
-                firstHihtPics.push_back(higtpick);
-            }
-        }
+    /**
+     забирает накопленный средний спектр и начинает накопление заново.
+     false, если ничего не накоплено.
+     */
+    bool takeCapturedSpectrum(std::vector<float>& spectrum, float& binWidth)
+    {
+        const juce::ScopedLock sl(retorDataLock);
+        if( retorDtata.getCount() == 0 )
+            return false;
         
-        /// /////////////////////////
-
-
-        cainSettings.highCutSlope = Slope::Slope_12;
-        if (firstHihtPics.size() >= 3)
-        {
-            higtpick = firstHihtPics[1];
+        spectrum = retorDtata.getMean();
+        binWidth = retorBinWidth;
+        retorDtata.reset();
+        return true;
+    }
 
-            if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[1] * binWidth, 20.f, 20000.f)) < 5) { cainSettings.highCutSlope = Slope::Slope_48; }
-            else if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[1] * binWidth, 20.f, 20000.f)) < 7) { cainSettings.highCutSlope = Slope::Slope_36; }
-            else if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[1] * binWidth, 20.f, 20000.f)) < 11) { cainSettings.highCutSlope = Slope::Slope_24; }
-        }
-        if (firstHihtPics.size() == 2)
-        {
-            higtpick = firstHihtPics[1];
 
-            if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[0] * binWidth, 20.f, 20000.f)) < 5) { cainSettings.highCutSlope = Slope::Slope_48; }
-            else if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[0] * binWidth, 20.f, 20000.f)) < 7) { cainSettings.highCutSlope = Slope::Slope_36; }
-            else if ((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f) - juce::mapFromLog10(firstHihtPics[0] * binWidth, 20.f, 20000.f)) < 11) { cainSettings.highCutSlope = Slope::Slope_24; }
-        }
-        if (firstHihtPics.size() == 1)
-        {
-            higtpick = firstHihtPics[0];
-        }
-        auto a = juce::mapToLog10((juce::mapFromLog10(higtpick * binWidth, 20.f, 20000.f)+0.1f), 20.f, 20000.f);
-        cainSettings.highCutFreq = 20 + std::floor(a);
+private:
+    SingleChannelSampleFifo* leftChannelFifo;
+    SingleChannelSampleFifo* rightChannelFifo;
+    
+    //скользящие окна последних fftSize сэмплов обоих каналов, кадр FFT считается, когда набралось getHopSize новых
+    juce::AudioBuffer<float> windowBuffer;
+    int samplesSinceLastFFT = 0;
+    std::atomic<bool> discardRequested { false };
+    
+    //пока шаг не задан явно, кадров столько, сколько просит пресет разрешения
+    std::atomic<float> overlap { 0.75f };
+    std::atomic<double> framesPerSecond { 0.0 };
+    std::atomic<bool> hopConfigured { false };
+    std::atomic<double> resolutionFramesPerSecond { 60.0 };
+    
+    std::atomic<StereoAnalysisMode> stereoAnalysisMode { StereoAnalysisMode::leftRight };
+    std::atomic<FFTOrder> fftOrder { order2048 };
+    
+    void pushSamples(int channel, const float* samples, int numSamples);
 
-        float normalizeLowpic = juce::mapFromLog10((lowpick+1) * binWidth, 20.f, 20000.f);
-        float normalizeHigtpic = juce::mapFromLog10((higtpick+1) * binWidth, 20.f, 20000.f);
-        float normalizeMidpic = normalizeLowpic + (normalizeHigtpic - normalizeLowpic) / 2;
+    SpectrumAccumulator retorDtata;
+    float retorBinWidth = 23.4375f;
+    juce::CriticalSection retorDataLock;
+    
+    AnalyzerTimings timings;
+    
+    FFTDataGenerator<std::vector<float>> fftDataGenerator;
+    std::vector<float> coherence;
+    
+    //последний кадр еще в буфере чтения, по нему пути перестраиваются при смене размеров
+    bool hasFFTData = false;
+    juce::Rectangle<float> generatedBounds;
+    
+    AnalyzerPathGenerator<juce::Path> leftPathGenerator, rightPathGenerator;
 
-        a = juce::mapToLog10(normalizeMidpic, 20.f, 20000.f) / binWidth;
-        int midpic = std::floor(a);
-        float midSlope = 0;
-        float midQuality = 0;
+    bool itWasAnalized = false;
+};
 
-        if (normalizeHigtpic - normalizeLowpic <= 0)
-        { midpic = 0;}
-        else
+/**
+ статичный слой интерфейса, отрисованный один раз в картинку в физических пикселях экрана.
+ перерисовывается, только если его сбросили в resized() или сменился масштаб дисплея.
+ */
+struct CachedLayer
+{
+    template<typename DrawFunction>
+    void draw(juce::Graphics& g, juce::Rectangle<int> bounds, DrawFunction&& drawLayer)
+    {
+        const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+        
+        if( image.isNull() || scale != imageScale || bounds != imageBounds )
         {
-            midSlope = 24 * (std::max(summData[lowpick], summData[higtpick]) - summData[midpic])/1000;
-            midQuality = normalizeHigtpic - normalizeLowpic;
-            midQuality = 1/(midQuality * 6 + 1);
+            imageScale = scale;
+            imageBounds = bounds;
+            
+            image = juce::Image(juce::Image::ARGB,
+                                juce::jmax(1, juce::roundToInt(bounds.getWidth() * scale)),
+                                juce::jmax(1, juce::roundToInt(bounds.getHeight() * scale)),
+                                true);
+            
+            juce::Graphics imageGraphics(image);
+            imageGraphics.addTransform(juce::AffineTransform::translation((float)-bounds.getX(), (float)-bounds.getY()).scaled(scale));
+            drawLayer(imageGraphics);
         }
-
-        cainSettings.peakGainInDecibels = midSlope;
-        cainSettings.peakQuality = midQuality;
-        cainSettings.peakFreq = 20 + midpic * binWidth;
-        cainSettings.lowCutFreq = 20 + lowpick * binWidth;
-        cainSettings.lowCutSlope = Slope::Slope_24;
-        cainSettings.peakBypassed = true;
-        cainSettings.highCutBypassed = true;
-        cainSettings.lowCutBypassed = true;
-
-
-
-        return cainSettings;
-
-
-
+        
+        //пиксель в пиксель, без пересэмплирования
+        g.drawImageTransformed(image, juce::AffineTransform::scale(1.f / scale).translated((float)bounds.getX(), (float)bounds.getY()));
     }
-
-
-private:
-    SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>* leftChannelFifo;
     
-    juce::AudioBuffer<float> monoBuffer;
+    void invalidate() { image = {}; }
+private:
+    juce::Image image;
+    float imageScale = 0;
+    juce::Rectangle<int> imageBounds;
+};
 
-    std::list<FFTSample> retorDtata;
+/**
+ подбор фильтров авто-эквалайзера по накопленному среднему спектру.
+ идет в пуле потоков редактора, чтобы поток сообщений не ждал поиска пиков.
+ прогресс пишется в свой для каждой задачи progress (0..1): отмененная задача может дописывать его,
+ пока не выйдет, и не должна задевать прогресс следующего запуска.
+ результат отдается в onFinished уже в потоке сообщений, отмененная задача его не отдает.
+ */
+struct AutoEQJob : juce::ThreadPoolJob
+{
+    AutoEQJob(std::vector<float> spectrum, float binWidth, ChainSettings settings,
+              std::shared_ptr<std::atomic<double>> progress, std::function<void(const ChainSettings&)> onFinished);
     
-    FFTDataGenerator<std::vector<float>> leftChannelFFTDataGenerator;
+    JobStatus runJob() override;
+private:
+    //false, если задачу отменили
+    bool generateNewFilters(ChainSettings& cainSettings);
     
-    AnalyzerPathGenerator<juce::Path> pathProducer;
-
-    bool itWasAnalized = false;
+    std::vector<float> summData;
+    float binWidth;
+    ChainSettings settings;
     
-    juce::Path leftChannelFFTPath;
+    std::shared_ptr<std::atomic<double>> progress;
+    std::function<void(const ChainSettings&)> onFinished;
 };
 
 struct ResponseCurveComponent: juce::Component,
@@ -464,40 +669,62 @@ juce::Timer
     
     void toggleAnalysisEnablement(bool enabled)
     {
+        //пока анализатор был выключен, кольца никто не читал
+        if( enabled && ! shouldShowFFTAnalysis )
+            pathProducer.discardPendingSamples();
+        
         shouldShowFFTAnalysis = enabled;
+        repaint(getAnalysisArea());
     }
 
     void toggleAutoEnablement(bool enabled) {
         recordPicsEnable = enabled;
     }
 
-    ChainSettings getNewFilters(ChainSettings settings) { return leftPathProducer.generateNewFilters(settings); }
+    bool takeCapturedSpectrum(std::vector<float>& spectrum, float& binWidth) { return pathProducer.takeCapturedSpectrum(spectrum, binWidth); }
+
+    void setAnalyzerOverlap(float overlap) { pathProducer.setOverlap(overlap); }
+    void setAnalyzerFramesPerSecond(double framesPerSecond) { pathProducer.setFramesPerSecond(framesPerSecond); }
+    void setStereoAnalysisMode(StereoAnalysisMode mode) { pathProducer.setStereoAnalysisMode(mode); }
+    void setAnalyzerResolution(AnalyzerResolution resolution) { pathProducer.setResolution(resolution); }
+
+    //время этапов анализа за последний кадр
+    AnalyzerTimings getAnalyzerTimings() const { return analyzerTimings; }
+    //когерентность каналов из последнего показанного кадра, только для потока сообщений
+    const std::vector<float>& getCoherence() const { return analyzerCoherence; }
 
     double getSamplerate() { return audioProcessor.getSampleRate(); }
 
     ChainSettings getSettings() { return getChainSettings(audioProcessor.apvts); }
 
-    void updateChain(ChainSettings settings);
-
     void updateResponseCurve();
 
 private:
     SimpleEQAudioProcessor& audioProcessor;
 
-    bool shouldShowFFTAnalysis = true;
-
-    bool recordPicsEnable = false;
+    //читаются фоновым потоком анализатора
+    std::atomic<bool> shouldShowFFTAnalysis { true };
+    std::atomic<bool> recordPicsEnable { false };
 
     juce::Atomic<bool> parametersChanged { false };
     
-    MonoChain monoChain;
+    //снимок коэффициентов процессора и то, по чему кривая АЧХ построена сейчас
+    ChainSnapshot::Ptr chainSnapshot;
+    ChainCoefficients curveCoefficients;
+    ResponseEvaluator responseEvaluator;
     
     juce::Path responseCurve;
 
-    void updateChain();
+    bool pullChainSnapshot();
+    bool updateCurveCoefficients();
+    void updateAnalyzerResolution();
     
     void drawBackgroundGrid(juce::Graphics& g);
     void drawTextLabels(juce::Graphics& g);
+    void drawBorder(juce::Graphics& g);
+    
+    //сетка под кривыми и рамка с подписями поверх них не меняются до resized()
+    CachedLayer backgroundLayer, overlayLayer;
     
     std::vector<float> getFrequencies();
     std::vector<float> getGains();
@@ -507,7 +734,56 @@ private:
     
     juce::Rectangle<int> getAnalysisArea();
     
-    PathProducer leftPathProducer, rightPathProducer;
+    PathProducer pathProducer;
+    
+    /**
+     готовый кадр анализатора. фоновый поток публикует его через TripleBuffer,
+     интерфейс забирает самый свежий и только рисует.
+     */
+    struct AnalyzerFrame
+    {
+        juce::Path leftPath, rightPath;
+        std::vector<float> coherence;
+        AnalyzerTimings timings;
+    };
+    
+    /**
+     фоновый поток анализатора: читает кольца аудиопотока, считает FFT, дБ и пути.
+     */
+    struct AnalyzerThread : juce::Thread
+    {
+        AnalyzerThread(ResponseCurveComponent& c) : juce::Thread("SimpleEQ Analyzer"), component(c) { }
+        void run() override;
+    private:
+        ResponseCurveComponent& component;
+    };
+    
+    void analyze();
+    
+    /**
+     частота таймера и фонового потока подстраивается под среднее время paint().
+     пока редактор не виден, поток спит, а таймер только проверяет видимость.
+     */
+    static constexpr int maxFramesPerSecond = 60, minFramesPerSecond = 15, idleTimerHz = 4;
+    std::atomic<int> framesPerSecond { maxFramesPerSecond };
+    std::atomic<bool> analyzerIdle { false };
+    double averagePaintMs = 0;
+    
+    void updateFrameRate();
+    //виден ли редактор на самом деле: не свернут и не закрыт другими окнами
+    bool isOnScreen();
+    
+    TripleBuffer<AnalyzerFrame> analyzerFrames;
+    juce::Path leftChannelFFTPath, rightChannelFFTPath;
+    std::vector<float> analyzerCoherence;
+    AnalyzerTimings analyzerTimings;
+    
+    //область анализатора для фонового потока, меняется в resized
+    juce::SpinLock analysisBoundsLock;
+    juce::Rectangle<float> analysisBounds;
+    
+    //объявлен последним, чтобы остановиться раньше, чем разрушится PathProducer
+    AnalyzerThread analyzerThread { *this };
 };
 //==============================================================================
 struct PowerButton : juce::ToggleButton { };
@@ -537,7 +813,8 @@ struct AnalyzerButton : juce::ToggleButton
 };
 /**
 */
-class SimpleEQAudioProcessorEditor  : public juce::AudioProcessorEditor
+class SimpleEQAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                      juce::Timer
 {
 public:
     SimpleEQAudioProcessorEditor (SimpleEQAudioProcessor&);
@@ -548,6 +825,12 @@ public:
     void resized() override;
 
 private:
+    void drawBackground(juce::Graphics&);
+    
+    void startAutoEQ();
+    void cancelAutoEQ();
+    void applyAutoEQSettings(const ChainSettings& settings);
+    
     // Эта ссылка предназначена для того, чтобы ваш редактор мог 
     // быстро получить доступ к объекту processor, который его создал.
     SimpleEQAudioProcessor& audioProcessor;
@@ -576,8 +859,13 @@ private:
 
     std::vector<juce::Component*> getComps();
     
+    //фон, заголовок и подписи секций
+    CachedLayer backgroundLayer;
+    
     PowerButton lowcutBypassButton, peakBypassButton, highcutBypassButton, autoEnabledButton;
     AnalyzerButton analyzerEnabledButton;
+    juce::ToggleButton linearPhaseButton { "Linear Phase" };
+    juce::ComboBox analyzerResolutionBox;
 
     
     using ButtonAttachment = APVTS::ButtonAttachment;
@@ -586,9 +874,24 @@ private:
                         peakBypassButtonAttachment,
                         highcutBypassButtonAttachment,
                         analyzerEnabledButtonAttachment,
-                        autoEnabledButtonAttachment;
+                        autoEnabledButtonAttachment,
+                        linearPhaseButtonAttachment;
+    
+    //пункты списка должны появиться раньше привязки, поэтому она создается в конструкторе
+    std::unique_ptr<APVTS::ComboBoxAttachment> analyzerResolutionBoxAttachment;
     
     LookAndFeel lnf;
+    
+    //подбор фильтров авто-эквалайзера в фоне; номер запуска отсекает результаты отмененных задач
+    juce::ThreadPool autoEQPool { 1 };
+    int autoEQRun = 0;
+    
+    //полоса читает autoEQProgress в потоке сообщений, а таймер копирует туда прогресс текущей задачи
+    std::shared_ptr<std::atomic<double>> autoEQJobProgress;
+    double autoEQProgress = 0;
+    juce::ProgressBar autoEQProgressBar { autoEQProgress };
+    
+    void timerCallback() override;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimpleEQAudioProcessorEditor)
 };
@@ -22,10 +22,23 @@ SimpleEQAudioProcessor::SimpleEQAudioProcessor()
                        )
 #endif
 {
+    for( auto* param : getParameters() )
+    {
+        if( auto* rap = dynamic_cast<juce::RangedAudioParameter*>(param) )
+            apvts.addParameterListener(rap->paramID, this);
+    }
 }
 
 SimpleEQAudioProcessor::~SimpleEQAudioProcessor()
 {
+    filterDesignThread.stopThread(1000);
+    cancelPendingUpdate();
+    
+    for( auto* param : getParameters() )
+    {
+        if( auto* rap = dynamic_cast<juce::RangedAudioParameter*>(param) )
+            apvts.removeParameterListener(rap->paramID, this);
+    }
 }
 
 //==============================================================================
@@ -63,7 +76,7 @@ bool SimpleEQAudioProcessor::isMidiEffect() const
 
 double SimpleEQAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return tailLengthSeconds.load();
 }
 
 int SimpleEQAudioProcessor::getNumPrograms()
@@ -103,10 +116,86 @@ void SimpleEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlo
     
     spec.sampleRate = sampleRate;
     
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
+    //по одному каскаду на каждую группу каналов: стерео - одна группа, 7.1.4 - три
+    const auto numChannels = juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels());
+    
+    //на смене режима выход каскадов задерживается на столько же, на сколько свертка
+    linearPhaseLatency = LinearPhaseDesigner::getLatencySamples(sampleRate);
+    filtersDelayPosition = 0;
+    
+    if( isUsingDoublePrecision() )
+    {
+        const auto lanes = SIMDBiquadCascade<double>::getMaxNumChannels();
+        
+        floatCascades.clear();
+        doubleCascades.resize((size_t)((numChannels + lanes - 1) / lanes));
+        for( auto& cascade : doubleCascades )
+            cascade.prepare(samplesPerBlock);
+        
+        dryFloat.setSize(0, 0);
+        dryDouble.setSize(numChannels, samplesPerBlock);
+        
+        filtersDelayFloat.setSize(0, 0);
+        filtersDelayDouble.setSize(numChannels, linearPhaseLatency);
+        filtersDelayDouble.clear();
+    }
+    else
+    {
+        const auto lanes = SIMDBiquadCascade<float>::getMaxNumChannels();
+        
+        doubleCascades.clear();
+        floatCascades.resize((size_t)((numChannels + lanes - 1) / lanes));
+        for( auto& cascade : floatCascades )
+            cascade.prepare(samplesPerBlock);
+        
+        dryDouble.setSize(0, 0);
+        dryFloat.setSize(numChannels, samplesPerBlock);
+        
+        filtersDelayDouble.setSize(0, 0);
+        filtersDelayFloat.setSize(numChannels, linearPhaseLatency);
+        filtersDelayFloat.clear();
+    }
+    
+    chainSmoother.reset(sampleRate, smoothingRampSeconds);
+    
+    designSampleRate = sampleRate;
+    {
+        //фильтры только что сброшены, поэтому коэффициенты нужно опубликовать заново
+        const juce::ScopedLock sl(designLock);
+        designedSampleRate = 0;
+        
+        //длина ядра зависит от частоты дискретизации
+        linearPhaseDesigner.prepare(sampleRate);
+        linearPhaseKernels.prepareBuffers([numPartitions = linearPhaseDesigner.getNumPartitions()](LinearPhaseKernel& kernel)
+        {
+            kernel.prepare(numPartitions, LinearPhaseDesigner::numBins);
+        });
+    }
+    
+    linearPhaseConvolver.prepare(numChannels, linearPhaseDesigner.getNumPartitions());
+    linearPhaseActive = false;
+    modePrimingSamples = 0;
+    modeCrossfadeSamples = 0;
+    
+    designFilters();
+    applyPendingCoefficients(true);
+    
+    //здесь не аудиопоток, так что задержку можно сообщить сразу, до первого блока
+    reportedLatency = linearPhaseActive ? linearPhaseLatency : 0;
+    pendingLatencySamples = reportedLatency;
+    setLatencySamples(reportedLatency);
+    
+    //сразу в нужном состоянии, чтобы не было перехода в первом блоке
+    crossfadeGains.resize((size_t)samplesPerBlock);
+    filtersGain.reset(sampleRate, identityCrossfadeSeconds);
+    filtersGain.setCurrentAndTargetValue(isIdentity(chainCoefficients.getReadBuffer().settings) ? 0.f : 1.f);
     
-    updateFilters();
+    suspended = false;
+    silentSamples = 0;
+    
+    //поток мог остаться запущенным с прошлого prepareToPlay, тогда его нужно разбудить под новую частоту
+    filterDesignThread.startThread();
+    filterDesignThread.notify();
     
     leftChannelFifo.prepare(samplesPerBlock);
     rightChannelFifo.prepare(samplesPerBlock);
@@ -122,6 +211,7 @@ void SimpleEQAudioProcessor::releaseResources()
 {
     // Когда воспроизведение остановится, вы можете использовать это
     // как возможность освободить любую свободную память и т.д.
+    filterDesignThread.stopThread(1000);
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -132,11 +222,9 @@ bool SimpleEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
     return true;
   #else
     // Это место, где вы проверяете, поддерживается ли макет.
-    // В этом шаблонном коде мы поддерживаем только моно или стерео.
-    // Некоторые хосты плагинов, такие как некоторые версии GarageBand, 
-    // загружают только те плагины, которые поддерживают расположение стереошин.
-    if (//layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo()
-        layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Параметры у всех каналов общие, поэтому подходит любое расположение:
+    // моно, стерео, 5.1, 7.1.4, амбисоник и т.д.
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // При этом проверяется, соответствует ли входная компоновка выходной
@@ -151,6 +239,17 @@ bool SimpleEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
 #endif
 
 void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples(buffer);
+}
+
+void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples(buffer);
+}
+
+template<typename SampleType>
+void SimpleEQAudioProcessor::processSamples(juce::AudioBuffer<SampleType>& buffer)
 {
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
@@ -165,9 +264,28 @@ void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juc
         buffer.clear (i, 0, buffer.getNumSamples());
 
 
-    updateFilters();
+    //в оффлайн рендере фоновый поток может не успеть, поэтому считаем здесь же
+    if( isNonRealtime() )
+        designFilters();
+    
+    applyPendingCoefficients(suspended);
+    updateReportedLatency();
     
-    juce::dsp::AudioBlock<float> block(buffer);
+    juce::dsp::AudioBlock<SampleType> block(buffer);
+    
+    const auto numSamples = buffer.getNumSamples();
+    const auto inputIsSilent = isSilent(buffer, totalNumInputChannels);
+    
+    if( suspended )
+    {
+        //состояние фильтров уже сброшено, а тишина на входе дает тишину на выходе
+        if( inputIsSilent )
+            return;
+        
+        //продолжаем ровно с того сэмпла, где вернулся сигнал
+        block = block.getSubBlock((size_t)findFirstAudibleSample(buffer, totalNumInputChannels));
+        suspended = false;
+    }
     
 //    buffer.clear();
 
@@ -179,18 +297,132 @@ void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juc
   //  juce::dsp::ProcessContextReplacing<float> stereoContext(block);
  //   osc.process(stereoContext);
     
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
-    
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
-    
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
+    if( modeCrossfadeSamples > 0 )
+    {
+        processModeCrossfade(block);
+    }
+    else if( linearPhaseActive )
+    {
+        //каскадам тоже нужен вход до свертки
+        if( modePrimingSamples > 0 )
+            primeFilters(block);
+        
+        //задержка в этом режиме должна оставаться постоянной, поэтому свертка работает всегда
+        linearPhaseConvolver.process(block);
+    }
+    else
+    {
+        //вход нужен свертке до обработки каскадами
+        const auto priming = modePrimingSamples > 0;
+        if( priming )
+            primeLinearPhase(block);
+        
+        //пока идет рампа, цепочка еще не тождественна
+        const auto identity = isIdentity(chainCoefficients.getReadBuffer().settings) && ! chainSmoother.isSmoothing();
+        const auto targetGain = identity ? 0.f : 1.f;
+        
+        if( targetGain != filtersGain.getTargetValue() )
+            filtersGain.setTargetValue(targetGain);
+        
+        if( filtersGain.isSmoothing() )
+            processCrossfaded(block);
+        else if( targetGain > 0.f )
+            processFilters(block);
+        
+        //иначе звук проходит как есть
+        
+        //к переходу в линии задержки должен быть выход каскадов за всю задержку свертки
+        if( priming )
+            delayFilters(block, false);
+    }
     
     leftChannelFifo.update(buffer);
     rightChannelFifo.update(buffer);
     
+    silentSamples = inputIsSilent ? silentSamples + numSamples : 0;
+    
+    if( inputIsSilent && hasChainDecayed() )
+    {
+        resetCascades();
+        linearPhaseConvolver.reset();
+        
+        //на тишине прогревать нечего, режим меняется сразу
+        if( modePrimingSamples > 0 )
+        {
+            modePrimingSamples = 0;
+            linearPhaseActive = ! linearPhaseActive;
+        }
+        
+        suspended = true;
+    }
+    
+    updateReportedLatency();
+}
+
+template<typename SampleType>
+bool SimpleEQAudioProcessor::isSilent(const juce::AudioBuffer<SampleType>& buffer, int numChannels)
+{
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        if( buffer.getMagnitude(ch, 0, buffer.getNumSamples()) > (SampleType)silenceThreshold )
+            return false;
+    }
+    
+    return true;
+}
+
+template<typename SampleType>
+int SimpleEQAudioProcessor::findFirstAudibleSample(const juce::AudioBuffer<SampleType>& buffer, int numChannels)
+{
+    auto first = buffer.getNumSamples();
+    
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        auto* data = buffer.getReadPointer(ch);
+        
+        for( int i = 0; i < first; ++i )
+        {
+            if( std::abs(data[i]) > (SampleType)silenceThreshold )
+            {
+                first = i;
+                break;
+            }
+        }
+    }
+    
+    return first;
+}
+
+bool SimpleEQAudioProcessor::hasChainDecayed() const
+{
+    //во время перехода звучат оба пути
+    if( modeCrossfadeSamples > 0 )
+        return false;
+    
+    //свертка помнит вход на всю длину ядра и еще одну часть в выходном буфере
+    if( linearPhaseActive )
+        return silentSamples >= LinearPhaseDesigner::getKernelLength(getSampleRate()) + LinearPhaseDesigner::partitionSize;
+    
+    if( filtersGain.isSmoothing() || chainSmoother.isSmoothing() )
+        return false;
+    
+    //фильтры не работают, звук идет как есть
+    if( filtersGain.getCurrentValue() == 0.f )
+        return true;
+    
+    for( auto& cascade : floatCascades )
+    {
+        if( cascade.getMaxStateMagnitude() > silenceThreshold )
+            return false;
+    }
+    
+    for( auto& cascade : doubleCascades )
+    {
+        if( cascade.getMaxStateMagnitude() > silenceThreshold )
+            return false;
+    }
+    
+    return true;
 }
 
 //==============================================================================
@@ -225,7 +457,8 @@ void SimpleEQAudioProcessor::setStateInformation (const void* data, int sizeInBy
     if( tree.isValid() )
     {
         apvts.replaceState(tree);
-        updateFilters();
+        ++parametersVersion;
+        filterDesignThread.notify();
     }
 }
 
@@ -245,67 +478,639 @@ ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
     settings.peakBypassed = apvts.getRawParameterValue("Peak Bypassed")->load() > 0.5f;
     settings.highCutBypassed = apvts.getRawParameterValue("HighCut Bypassed")->load() > 0.5f;
     
+    settings.linearPhase = apvts.getRawParameterValue("Linear Phase")->load() > 0.5f;
+    
     return settings;
 }
 
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate)
+bool isIdentity(const ChainSettings& chainSettings)
+{
+    const auto lowCutNeutral = chainSettings.lowCutBypassed
+        || (chainSettings.lowCutFreq <= 20.f && chainSettings.lowCutSlope == Slope_12);
+    const auto peakNeutral = chainSettings.peakBypassed || chainSettings.peakGainInDecibels == 0.f;
+    const auto highCutNeutral = chainSettings.highCutBypassed
+        || (chainSettings.highCutFreq >= 20000.f && chainSettings.highCutSlope == Slope_12);
+    
+    return lowCutNeutral && peakNeutral && highCutNeutral;
+}
+
+static void setBiquad(BiquadCoefficients& dest, double b0, double b1, double b2, double a0, double a1, double a2)
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
-                                                               chainSettings.peakFreq,
-                                                               chainSettings.peakQuality,
-                                                               juce::Decibels::decibelsToGain(chainSettings.peakGainInDecibels));
+    const auto a0Inv = 1.0 / a0;
+    
+    dest = { b0 * a0Inv, b1 * a0Inv, b2 * a0Inv, a1 * a0Inv, a2 * a0Inv };
 }
 
-void SimpleEQAudioProcessor::updatePeakFilter(const ChainSettings &chainSettings)
+void designPeakFilter(BiquadCoefficients& coefficients, const ChainSettings& chainSettings, double sampleRate)
 {
-    auto peakCoefficients = makePeakFilter(chainSettings, getSampleRate());
+    const auto gain = juce::Decibels::decibelsToGain((double)chainSettings.peakGainInDecibels);
+    const auto A = juce::jmax(0.0, std::sqrt(gain));
+    const auto omega = juce::MathConstants<double>::twoPi * juce::jmax((double)chainSettings.peakFreq, 2.0) / sampleRate;
+    const auto alpha = std::sin(omega) / (chainSettings.peakQuality * 2.0);
+    const auto c2 = -2.0 * std::cos(omega);
     
-    leftChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    rightChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
+    setBiquad(coefficients,
+              1.0 + alpha * A, c2, 1.0 - alpha * A,
+              1.0 + alpha / A, c2, 1.0 - alpha / A);
+}
+
+//Баттерворт четного порядка: каскад биквадов с одной частотой и разной добротностью
+static void designButterworth(std::array<BiquadCoefficients, 4>& stages, float frequency, Slope slope, double sampleRate, bool isHighPass)
+{
+    const auto order = 2 * (slope + 1);
+    const auto tanValue = std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+    const auto n = isHighPass ? tanValue : 1.0 / tanValue;
+    const auto nSquared = n * n;
     
-    updateCoefficients(leftChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
-    updateCoefficients(rightChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    for( int i = 0; i < order / 2; ++i )
+    {
+        const auto Q = 1.0 / (2.0 * std::cos((2.0 * i + 1.0) * juce::MathConstants<double>::pi / (order * 2.0)));
+        const auto invQ = 1.0 / Q;
+        const auto c1 = 1.0 / (1.0 + invQ * n + nSquared);
+        
+        if( isHighPass )
+            setBiquad(stages[i], c1, c1 * -2.0, c1, 1.0, c1 * 2.0 * (nSquared - 1.0), c1 * (1.0 - invQ * n + nSquared));
+        else
+            setBiquad(stages[i], c1, c1 * 2.0, c1, 1.0, c1 * 2.0 * (1.0 - nSquared), c1 * (1.0 - invQ * n + nSquared));
+    }
+}
+
+void designLowCutFilter(std::array<BiquadCoefficients, 4>& stages, const ChainSettings& chainSettings, double sampleRate)
+{
+    designButterworth(stages, chainSettings.lowCutFreq, chainSettings.lowCutSlope, sampleRate, true);
 }
 
-void updateCoefficients(Coefficients &old, const Coefficients &replacements)
+void designHighCutFilter(std::array<BiquadCoefficients, 4>& stages, const ChainSettings& chainSettings, double sampleRate)
 {
-    *old = *replacements;
+    designButterworth(stages, chainSettings.highCutFreq, chainSettings.highCutSlope, sampleRate, false);
 }
 
-void SimpleEQAudioProcessor::updateLowCutFilters(const ChainSettings &chainSettings)
+ChainCoefficients makeChainCoefficients(const ChainSettings& chainSettings, double sampleRate)
 {
-    auto cutCoefficients = makeLowCutFilter(chainSettings, getSampleRate());
-    auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
-    auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
+    ChainCoefficients result;
+    result.settings = chainSettings;
+    result.sampleRate = sampleRate;
     
-    leftChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    rightChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
+    designPeakFilter(result.peak, chainSettings, sampleRate);
+    designLowCutFilter(result.lowCut, chainSettings, sampleRate);
+    designHighCutFilter(result.highCut, chainSettings, sampleRate);
     
-    updateCutFilter(rightLowCut, cutCoefficients, chainSettings.lowCutSlope);
-    updateCutFilter(leftLowCut, cutCoefficients, chainSettings.lowCutSlope);
+    return result;
 }
 
-void SimpleEQAudioProcessor::updateHighCutFilters(const ChainSettings &chainSettings)
+//за сколько сэмплов импульсная характеристика каскада падает ниже порога тишины.
+//по радиусам полюсов каждой ступени, время ступеней складывается с запасом
+static double getDecaySamples(const CascadeStages& stages, double sampleRate)
 {
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
+    const auto logThreshold = std::log(1.0e-6);
+    //полюс на окружности не затухает, ограничиваем десятью секундами на любой частоте дискретизации
+    const auto maxDecaySamples = 10.0 * sampleRate;
+    double total = 0;
     
-    auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
-    auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
-    
-    leftChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    rightChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    for( auto* stage : stages )
+    {
+        if( stage == nullptr )
+            continue;
+        
+        const auto a1 = (*stage)[3], a2 = (*stage)[4];
+        const auto discriminant = a1 * a1 - 4.0 * a2;
+        
+        double radius;
+        if( discriminant < 0 )
+            radius = std::sqrt(a2);
+        else
+            radius = juce::jmax(std::abs(-a1 + std::sqrt(discriminant)), std::abs(-a1 - std::sqrt(discriminant))) * 0.5;
+        
+        if( radius >= 1.0 )
+            return maxDecaySamples;
+        
+        if( radius > 0.0 )
+            total += logThreshold / std::log(radius);
+        
+        //сама ступень - КИХ второго порядка
+        total += 2.0;
+    }
     
-    updateCutFilter(leftHighCut, highCutCoefficients, chainSettings.highCutSlope);
-    updateCutFilter(rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
+    return juce::jmin(total, maxDecaySamples);
 }
 
-void SimpleEQAudioProcessor::updateFilters()
+void SimpleEQAudioProcessor::parameterChanged(const juce::String&, float)
 {
+    //хост может звать это из аудиопотока, а notify() берет блокировку,
+    //поэтому только отмечаем новую версию - поток расчета сам ее заметит
+    ++parametersVersion;
+}
+
+void SimpleEQAudioProcessor::designFilters()
+{
+    const juce::ScopedLock sl(designLock);
+    
+    const auto version = parametersVersion.load();
+    const auto sampleRate = designSampleRate.load();
+    
+    if( sampleRate <= 0 || (version == designedVersion && sampleRate == designedSampleRate) )
+        return;
+    
+    designedVersion = version;
+    
     auto chainSettings = getChainSettings(apvts);
+    
+    //версия меняется и от кнопок анализатора, а коэффициенты пересчитываем только если реально что-то поменялось
+    if( chainSettings == designedSettings && sampleRate == designedSampleRate )
+        return;
+    
+    designedSettings = chainSettings;
+    designedSampleRate = sampleRate;
+    
+    auto& coefficients = chainCoefficients.getWriteBuffer();
+    coefficients = makeChainCoefficients(chainSettings, sampleRate);
+    coefficients.version = version;
+    
+    //ядро публикуется раньше коэффициентов, так что аудиопоток не увидит режим без ядра
+    if( chainSettings.linearPhase )
+    {
+        linearPhaseDesigner.design(linearPhaseKernels.getWriteBuffer(), getCascadeStages(coefficients));
+        linearPhaseKernels.publish();
+    }
+    
+    publishSnapshot(coefficients);
+    chainCoefficients.publish();
+    
+    tailLengthSeconds = chainSettings.linearPhase ? LinearPhaseDesigner::getKernelLength(sampleRate) / sampleRate
+                                                  : getDecaySamples(getCascadeStages(coefficients), sampleRate) / sampleRate;
+    
+}
+
+void SimpleEQAudioProcessor::publishSnapshot(const ChainCoefficients& coefficients)
+{
+    //версия своя: номер версии параметров не меняется при смене частоты дискретизации
+    const auto version = chainSnapshotVersion.load() + 1;
+    ChainSnapshot::Ptr snapshot = new ChainSnapshot(coefficients, version);
+    
+    {
+        const juce::SpinLock::ScopedLockType sl(snapshotLock);
+        std::swap(chainSnapshot, snapshot);
+    }
+    
+    chainSnapshotVersion = version;
+    //предыдущий снимок освобождается здесь, вне блокировки, если интерфейс его уже не держит
+}
 
-    updateLowCutFilters(chainSettings);
-    updatePeakFilter(chainSettings);
-    updateHighCutFilters(chainSettings);
+ChainSnapshot::Ptr SimpleEQAudioProcessor::getChainSnapshot() const
+{
+    const juce::SpinLock::ScopedLockType sl(snapshotLock);
+    return chainSnapshot;
+}
+
+void SimpleEQAudioProcessor::applyPendingCoefficients(bool switchModeImmediately)
+{
+    if( linearPhaseKernels.pull() )
+        linearPhaseConvolver.setKernel(linearPhaseKernels.getReadBuffer());
+    
+    if( ! chainCoefficients.pull() )
+        return;
+    
+    const auto& coefficients = chainCoefficients.getReadBuffer();
+    
+    //режим, к которому уже идем: прогрев другого пути тоже считается переключением
+    const auto linearPhaseRequested = modePrimingSamples > 0 ? ! linearPhaseActive : linearPhaseActive;
+    
+    if( coefficients.settings.linearPhase != linearPhaseRequested )
+    {
+        if( modePrimingSamples > 0 )
+        {
+            //прогреваемый путь еще не слышен, просто остаемся в текущем режиме
+            modePrimingSamples = 0;
+        }
+        else if( switchModeImmediately )
+        {
+            //при смене режима состояние другого пути устарело
+            if( coefficients.settings.linearPhase )
+                linearPhaseConvolver.reset();
+            else
+                resetCascades();
+            
+            modeCrossfadeSamples = 0;
+            linearPhaseActive = coefficients.settings.linearPhase;
+        }
+        else if( modeCrossfadeSamples > 0 )
+        {
+            //переход еще идет, оба пути работают: разворачиваем его с того же места
+            linearPhaseActive = coefficients.settings.linearPhase;
+            modeCrossfadeSamples = modeCrossfadeLength - modeCrossfadeSamples;
+        }
+        else if( coefficients.settings.linearPhase )
+        {
+            //свертка заработает в полную силу, когда через нее пройдет целое ядро
+            linearPhaseConvolver.reset();
+            modePrimingSamples = LinearPhaseDesigner::getKernelLength(coefficients.sampleRate) + LinearPhaseDesigner::partitionSize;
+        }
+        else
+        {
+            //каскады готовы сразу, но на переходе их выход идет через линию задержки,
+            //и ее нужно заполнить, пока еще слышна свертка
+            resetCascades();
+            filtersGain.setCurrentAndTargetValue(1.f);
+            modePrimingSamples = linearPhaseLatency;
+        }
+    }
+    
+    //в линейно-фазовом режиме переходы сглаживает смена ядер, рампа IIR не нужна.
+    //в паузе состояние фильтров нулевое, так что щелкать нечему
+    if( linearPhaseActive || suspended )
+        chainSmoother.reset(coefficients.sampleRate, smoothingRampSeconds);
+    
+    chainSmoother.setTarget(coefficients.settings);
+    
+    //если сглаживать нечего, сразу ставим готовые коэффициенты из фонового потока
+    if( ! chainSmoother.isSmoothing() )
+        applyCoefficients(coefficients);
+}
+
+void SimpleEQAudioProcessor::updateReportedLatency()
+{
+    //выход задержан, пока слышна свертка или идет переход, где каскады выровнены с ней.
+    //к каскадам задержка падает только в конце перехода, к свертке - в его начале
+    const auto latency = (linearPhaseActive || modeCrossfadeSamples > 0) ? linearPhaseLatency : 0;
+    
+    if( latency == reportedLatency )
+        return;
+    
+    reportedLatency = latency;
+    pendingLatencySamples = latency;
+    triggerAsyncUpdate();
+}
+
+void SimpleEQAudioProcessor::handleAsyncUpdate()
+{
+    setLatencySamples(pendingLatencySamples.load());
+}
+
+template<typename SampleType>
+std::vector<SIMDBiquadCascade<SampleType>>& SimpleEQAudioProcessor::getCascades()
+{
+    if constexpr (std::is_same_v<SampleType, float>)
+        return floatCascades;
+    else
+        return doubleCascades;
+}
+
+template<typename SampleType>
+void SimpleEQAudioProcessor::processCascades(const juce::dsp::AudioBlock<SampleType>& block)
+{
+    auto& cascades = getCascades<SampleType>();
+    const auto lanes = (size_t)SIMDBiquadCascade<SampleType>::getMaxNumChannels();
+    
+    for( size_t group = 0; group < cascades.size(); ++group )
+    {
+        const auto firstChannel = group * lanes;
+        if( firstChannel >= block.getNumChannels() )
+            break;
+        
+        cascades[group].process(block.getSubsetChannelBlock(firstChannel,
+                                                                   juce::jmin(lanes, block.getNumChannels() - firstChannel)));
+    }
+}
+
+template<typename SampleType>
+void SimpleEQAudioProcessor::processFilters(const juce::dsp::AudioBlock<SampleType>& block)
+{
+    if( chainSmoother.isSmoothing() )
+        processSmoothed(block);
+    else
+        processCascades(block);
+}
+
+template<typename SampleType>
+juce::AudioBuffer<SampleType>& SimpleEQAudioProcessor::getDryBuffer()
+{
+    if constexpr (std::is_same_v<SampleType, float>)
+        return dryFloat;
+    else
+        return dryDouble;
+}
+
+template<typename SampleType>
+juce::AudioBuffer<SampleType>& SimpleEQAudioProcessor::getFiltersDelay()
+{
+    if constexpr (std::is_same_v<SampleType, float>)
+        return filtersDelayFloat;
+    else
+        return filtersDelayDouble;
+}
+
+template<typename SampleType>
+void SimpleEQAudioProcessor::processCrossfaded(const juce::dsp::AudioBlock<SampleType>& block)
+{
+    auto& dry = getDryBuffer<SampleType>();
+    const auto numChannels = juce::jmin(block.getNumChannels(), (size_t)dry.getNumChannels());
+    const auto chunkSize = juce::jmin((size_t)dry.getNumSamples(), crossfadeGains.size());
+    
+    if( chunkSize == 0 )
+        return;
+    
+    for( size_t start = 0; start < block.getNumSamples(); start += chunkSize )
+    {
+        auto chunk = block.getSubBlock(start, juce::jmin(chunkSize, block.getNumSamples() - start));
+        const auto numSamples = (int)chunk.getNumSamples();
+        
+        for( size_t ch = 0; ch < numChannels; ++ch )
+            dry.copyFrom((int)ch, 0, chunk.getChannelPointer(ch), numSamples);
+        
+        processFilters(chunk);
+        
+        //одна кривая на все каналы
+        for( int i = 0; i < numSamples; ++i )
+            crossfadeGains[(size_t)i] = filtersGain.getNextValue();
+        
+        for( size_t ch = 0; ch < numChannels; ++ch )
+        {
+            auto* wet = chunk.getChannelPointer(ch);
+            auto* dryData = dry.getReadPointer((int)ch);
+            
+            for( int i = 0; i < numSamples; ++i )
+                wet[i] = dryData[i] + (wet[i] - dryData[i]) * (SampleType)crossfadeGains[(size_t)i];
+        }
+    }
+    
+    //фильтры выключились: сбрасываем их состояние, чтобы при включении не было щелчка от старых отсчетов
+    if( ! filtersGain.isSmoothing() && filtersGain.getCurrentValue() == 0.f )
+        resetCascades();
+}
+
+template<typename SampleType>
+void SimpleEQAudioProcessor::primeLinearPhase(const juce::dsp::AudioBlock<SampleType>& block)
+{
+    auto& dry = getDryBuffer<SampleType>();
+    const auto numChannels = juce::jmin(block.getNumChannels(), (size_t)dry.getNumChannels());
+    const auto chunkSize = (size_t)dry.getNumSamples();
+    
+    if( chunkSize == 0 )
+        return;
+    
+    //свертка получает копию входа, ее выход пока не слышен
+    for( size_t start = 0; start < block.getNumSamples(); start += chunkSize )
+    {
+        const auto numSamples = juce::jmin(chunkSize, block.getNumSamples() - start);
+        
+        for( size_t ch = 0; ch < numChannels; ++ch )
+            dry.copyFrom((int)ch, 0, block.getChannelPointer(ch) + start, (int)numSamples);
+        
+        linearPhaseConvolver.process(juce::dsp::AudioBlock<SampleType>(dry).getSubsetChannelBlock(0, numChannels).getSubBlock(0, numSamples));
+    }
+    
+    modePrimingSamples -= (int)block.getNumSamples();
+    
+    //со следующего блока начинается переход к свертке
+    if( modePrimingSamples <= 0 )
+    {
+        modePrimingSamples = 0;
+        linearPhaseActive = true;
+        modeCrossfadeSamples = modeCrossfadeLength;
+    }
+}
+
+template<typename SampleType>
+void SimpleEQAudioProcessor::primeFilters(const juce::dsp::AudioBlock<SampleType>& block)
+{
+    auto& dry = getDryBuffer<SampleType>();
+    const auto numChannels = juce::jmin(block.getNumChannels(), (size_t)dry.getNumChannels());
+    const auto chunkSize = (size_t)dry.getNumSamples();
+    
+    if( chunkSize == 0 )
+        return;
+    
+    //каскады получают копию входа, их выход пока копится только в линии задержки
+    for( size_t start = 0; start < block.getNumSamples(); start += chunkSize )
+    {
+        const auto numSamples = juce::jmin(chunkSize, block.getNumSamples() - start);
+        
+        for( size_t ch = 0; ch < numChannels; ++ch )
+            dry.copyFrom((int)ch, 0, block.getChannelPointer(ch) + start, (int)numSamples);
+        
+        auto filters = juce::dsp::AudioBlock<SampleType>(dry).getSubsetChannelBlock(0, numChannels).getSubBlock(0, numSamples);
+        processFilters(filters);
+        delayFilters(filters, false);
+    }
+    
+    modePrimingSamples -= (int)block.getNumSamples();
+    
+    //со следующего блока начинается переход к каскадам
+    if( modePrimingSamples <= 0 )
+    {
+        modePrimingSamples = 0;
+        linearPhaseActive = false;
+        modeCrossfadeSamples = modeCrossfadeLength;
+    }
+}
+
+template<typename SampleType>
+void SimpleEQAudioProcessor::delayFilters(const juce::dsp::AudioBlock<SampleType>& block, bool replaceWithDelayed)
+{
+    auto& delay = getFiltersDelay<SampleType>();
+    const auto length = delay.getNumSamples();
+    
+    if( length == 0 )
+        return;
+    
+    const auto numChannels = juce::jmin(block.getNumChannels(), (size_t)delay.getNumChannels());
+    const auto numSamples = (int)block.getNumSamples();
+    
+    //кольцевой буфер ровно на задержку свертки: прочитанный отсчет сразу заменяется новым
+    for( size_t ch = 0; ch < numChannels; ++ch )
+    {
+        auto* data = block.getChannelPointer(ch);
+        auto* line = delay.getWritePointer((int)ch);
+        auto position = filtersDelayPosition;
+        
+        for( int i = 0; i < numSamples; ++i )
+        {
+            const auto delayed = line[position];
+            line[position] = data[i];
+            
+            if( replaceWithDelayed )
+                data[i] = delayed;
+            
+            if( ++position == length )
+                position = 0;
+        }
+    }
+    
+    filtersDelayPosition = (filtersDelayPosition + numSamples) % length;
+}
+
+template<typename SampleType>
+void SimpleEQAudioProcessor::processModeCrossfade(const juce::dsp::AudioBlock<SampleType>& block)
+{
+    auto& dry = getDryBuffer<SampleType>();
+    const auto numChannels = juce::jmin(block.getNumChannels(), (size_t)dry.getNumChannels());
+    const auto chunkSize = juce::jmin((size_t)dry.getNumSamples(), crossfadeGains.size());
+    
+    if( chunkSize == 0 )
+        return;
+    
+    for( size_t start = 0; start < block.getNumSamples(); start += chunkSize )
+    {
+        auto chunk = block.getSubBlock(start, juce::jmin(chunkSize, block.getNumSamples() - start));
+        const auto numSamples = (int)chunk.getNumSamples();
+        
+        for( size_t ch = 0; ch < numChannels; ++ch )
+            dry.copyFrom((int)ch, 0, chunk.getChannelPointer(ch), numSamples);
+        
+        //в chunk - свертка, в копии - каскады. если цепочка тождественна, IIR путь - это сам вход
+        linearPhaseConvolver.process(chunk);
+        
+        auto filters = juce::dsp::AudioBlock<SampleType>(dry).getSubsetChannelBlock(0, numChannels).getSubBlock(0, (size_t)numSamples);
+        
+        if( filtersGain.getCurrentValue() > 0.f )
+            processFilters(filters);
+        
+        //свертка задерживает сигнал, так что каскады смешиваются с ней через такую же задержку
+        delayFilters(filters, true);
+        
+        //вес свертки
+        for( int i = 0; i < numSamples; ++i )
+        {
+            const auto progress = 1.f - (float)juce::jmax(0, modeCrossfadeSamples - i) / (float)modeCrossfadeLength;
+            crossfadeGains[(size_t)i] = linearPhaseActive ? progress : 1.f - progress;
+        }
+        
+        modeCrossfadeSamples = juce::jmax(0, modeCrossfadeSamples - numSamples);
+        
+        for( size_t ch = 0; ch < numChannels; ++ch )
+        {
+            auto* wet = chunk.getChannelPointer(ch);
+            auto* iir = dry.getReadPointer((int)ch);
+            
+            for( int i = 0; i < numSamples; ++i )
+                wet[i] = iir[i] + (wet[i] - iir[i]) * (SampleType)crossfadeGains[(size_t)i];
+        }
+    }
+}
+
+template<typename SampleType>
+void SimpleEQAudioProcessor::processSmoothed(const juce::dsp::AudioBlock<SampleType>& block)
+{
+    const auto& target = chainCoefficients.getReadBuffer();
+    const auto numSamples = (int)block.getNumSamples();
+    juce::uint32 numDesigns = 0;
+    bool targetApplied = false;
+    
+    smoothedCoefficients.settings = target.settings;
+    smoothedCoefficients.sampleRate = target.sampleRate;
+    smoothedCoefficients.version = target.version;
+    
+    for( int start = 0; start < numSamples; start += smoothingSubBlockSize )
+    {
+        const auto subBlockSize = juce::jmin(smoothingSubBlockSize, numSamples - start);
+        auto subBlock = block.getSubBlock((size_t)start, (size_t)subBlockSize);
+        
+        if( ! chainSmoother.isSmoothing() )
+        {
+            //рампа закончилась посреди блока - дальше точные коэффициенты из фонового потока
+            applyCoefficients(target);
+            targetApplied = true;
+            processCascades(block.getSubBlock((size_t)start));
+            break;
+        }
+        
+        //выключенные полосы не слышны, их не пересчитываем
+        const auto lowCutSmoothing = chainSmoother.isLowCutSmoothing() && ! target.settings.lowCutBypassed;
+        const auto peakSmoothing = chainSmoother.isPeakSmoothing() && ! target.settings.peakBypassed;
+        const auto highCutSmoothing = chainSmoother.isHighCutSmoothing() && ! target.settings.highCutBypassed;
+        
+        //значения на середине под-блока, чтобы ступеньки были симметричны относительно рампы
+        auto chainSettings = chainSmoother.advance(subBlockSize / 2);
+        chainSmoother.advance(subBlockSize - subBlockSize / 2);
+        
+        //пересчитываем только те полосы, которые сейчас двигаются
+        if( lowCutSmoothing )
+            designLowCutFilter(smoothedCoefficients.lowCut, chainSettings, target.sampleRate);
+        else
+            smoothedCoefficients.lowCut = target.lowCut;
+        
+        if( peakSmoothing )
+            designPeakFilter(smoothedCoefficients.peak, chainSettings, target.sampleRate);
+        else
+            smoothedCoefficients.peak = target.peak;
+        
+        if( highCutSmoothing )
+            designHighCutFilter(smoothedCoefficients.highCut, chainSettings, target.sampleRate);
+        else
+            smoothedCoefficients.highCut = target.highCut;
+        
+        applyCoefficients(smoothedCoefficients);
+        processCascades(subBlock);
+        ++numDesigns;
+    }
+    
+    if( ! chainSmoother.isSmoothing() && ! targetApplied )
+        applyCoefficients(target);
+    
+    smoothingDesignsInLastBlock = numDesigns;
+    smoothingDesignsTotal += numDesigns;
+}
+
+SimpleEQAudioProcessor::SmoothingStats SimpleEQAudioProcessor::getSmoothingStats() const
+{
+    return { smoothingSubBlockSize, smoothingDesignsInLastBlock.load(), smoothingDesignsTotal.load() };
+}
+
+CascadeStages getCascadeStages(const ChainCoefficients& coefficients)
+{
+    const auto& chainSettings = coefficients.settings;
+    
+    //слоты каскада: 0-3 LowCut, 4 Peak, 5-8 HighCut
+    CascadeStages stages {};
+    
+    if( ! chainSettings.lowCutBypassed )
+    {
+        for( int i = 0; i <= chainSettings.lowCutSlope; ++i )
+            stages[i] = &coefficients.lowCut[i];
+    }
+    
+    if( ! chainSettings.peakBypassed )
+        stages[4] = &coefficients.peak;
+    
+    if( ! chainSettings.highCutBypassed )
+    {
+        for( int i = 0; i <= chainSettings.highCutSlope; ++i )
+            stages[5 + i] = &coefficients.highCut[i];
+    }
+    
+    return stages;
+}
+
+void SimpleEQAudioProcessor::resetCascades()
+{
+    for( auto& cascade : floatCascades )
+        cascade.reset();
+    
+    for( auto& cascade : doubleCascades )
+        cascade.reset();
+}
+
+void SimpleEQAudioProcessor::applyCoefficients(const ChainCoefficients& coefficients)
+{
+    const auto stages = getCascadeStages(coefficients);
+    
+    for( auto& cascade : floatCascades )
+        cascade.setStages(stages);
+    
+    for( auto& cascade : doubleCascades )
+        cascade.setStages(stages);
+}
+
+void SimpleEQAudioProcessor::FilterDesignThread::run()
+{
+    while( ! threadShouldExit() )
+    {
+        processor.designFilters();
+        
+        //изменения параметров поток замечает сам, раз в designPollMs;
+        //setStateInformation, prepareToPlay и stopThread будят его сразу
+        wait(designPollMs);
+    }
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout SimpleEQAudioProcessor::createParameterLayout()
@@ -352,7 +1157,12 @@ juce::AudioProcessorValueTreeState::ParameterLayout SimpleEQAudioProcessor::crea
     layout.add(std::make_unique<juce::AudioParameterBool>("LowCut Bypassed", "LowCut Bypassed", false));
     layout.add(std::make_unique<juce::AudioParameterBool>("Peak Bypassed", "Peak Bypassed", false));
     layout.add(std::make_unique<juce::AudioParameterBool>("HighCut Bypassed", "HighCut Bypassed", false));
+    layout.add(std::make_unique<juce::AudioParameterBool>("Linear Phase", "Linear Phase", false));
     layout.add(std::make_unique<juce::AudioParameterBool>("Analyzer Enabled", "Analyzer Enabled", true));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Analyzer Resolution",
+                                                            "Analyzer Resolution",
+                                                            juce::StringArray { "Low CPU", "Standard", "Fine", "High Res" },
+                                                            AnalyzerResolution_Standard));
     layout.add(std::make_unique<juce::AudioParameterBool>("Auto Enabled", "Auto Enabled", false));
     
     return layout;
@@ -11,137 +11,201 @@
 #include <JuceHeader.h>
 
 #include <array>
+#include <atomic>
+#include <cstring>
+
+#include "BiquadCascade.h"
+#include "LinearPhaseConvolver.h"
+
+/**
+ тройной буфер "побеждает последний": писатель заполняет getWriteBuffer() и вызывает publish(),
+ читатель через pull() забирает самый свежий опубликованный буфер.
+ ни одна из сторон не блокируется и не выделяет память, обмениваются только индексы.
+ счетчики показывают, сколько кадров писатель перезаписал непрочитанными
+ и сколько раз читатель пришел, а нового ничего не было.
+ */
 template<typename T>
-struct Fifo
+struct TripleBuffer
 {
-    void prepare(int numChannels, int numSamples)
+    T& getWriteBuffer() { return buffers[writeIndex]; }
+    
+    void publish()
     {
-        static_assert( std::is_same_v<T, juce::AudioBuffer<float>>,
-                      "prepare(numChannels, numSamples) should only be used when the Fifo is holding juce::AudioBuffer<float>");
-        for( auto& buffer : buffers)
-        {
-            buffer.setSize(numChannels,
-                           numSamples,
-                           false,   //clear everything?
-                           true,    //including the extra space?
-                           true);   //avoid reallocating if you can?
-            buffer.clear();
-        }
+        const auto previous = middle.exchange(writeIndex | newDataFlag, std::memory_order_acq_rel);
+        writeIndex = previous & indexMask;
+        
+        if( (previous & newDataFlag) != 0 )
+            numDroppedFrames.fetch_add(1, std::memory_order_relaxed);
     }
     
-    void prepare(size_t numElements)
+    bool pull()
     {
-        static_assert( std::is_same_v<T, std::vector<float>>,
-                      "prepare(numElements) should only be used when the Fifo is holding std::vector<float>");
-        for( auto& buffer : buffers )
+        if( (middle.load(std::memory_order_acquire) & newDataFlag) == 0 )
         {
-            buffer.clear();
-            buffer.resize(numElements, 0);
+            numEmptyPulls.fetch_add(1, std::memory_order_relaxed);
+            return false;
         }
+        
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
     }
     
-    bool push(const T& t)
+    juce::uint64 getNumDroppedFrames() const { return numDroppedFrames.load(std::memory_order_relaxed); }
+    juce::uint64 getNumEmptyPulls() const { return numEmptyPulls.load(std::memory_order_relaxed); }
+    
+    const T& getReadBuffer() const { return buffers[readIndex]; }
+    
+    //читатель может забрать содержимое обменом, писатель все равно перезапишет буфер целиком
+    T& getReadBuffer() { return buffers[readIndex]; }
+    
+    /**
+     подготовка всех трех буферов, например под новый размер.
+     только когда ни писатель, ни читатель не работают. неопубликованные данные сбрасываются.
+     */
+    template<typename PrepareFunction>
+    void prepareBuffers(PrepareFunction&& prepareBuffer)
     {
-        auto write = fifo.write(1);
-        if( write.blockSize1 > 0 )
-        {
-            buffers[write.startIndex1] = t;
-            return true;
-        }
+        for( auto& buffer : buffers )
+            prepareBuffer(buffer);
         
-        return false;
+        middle.store(middle.load() & indexMask);
     }
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int newDataFlag = 4;
+    
+    std::array<T, 3> buffers;
+    int writeIndex = 0, readIndex = 1;
+    std::atomic<int> middle { 2 };
+    
+    std::atomic<juce::uint64> numDroppedFrames { 0 }, numEmptyPulls { 0 };
+};
+
+enum Channel
+{
+    Right, //effectively 0
+    Left //effectively 1
+};
+
+/**
+ кольцевой буфер сэмплов для одного писателя (аудиопоток) и одного читателя (анализатор).
+ запись - одно-два копирования на блок, чтение - один-два непрерывных участка прямо в буфере, без копий.
+ емкость не зависит от размера блока хоста: блок любого размера просто занимает место в кольце.
+ */
+struct SampleRing
+{
+    SampleRing(int capacity) : buffer((size_t)capacity, 0.f), fifo(capacity) { }
     
-    bool pull(T& t)
+    //возвращает, сколько сэмплов поместилось. остальное отбрасывается и попадает в счетчик переполнений,
+    //непрочитанные данные не затираются
+    template<typename SampleType>
+    int write(const SampleType* samples, int numSamples)
     {
-        auto read = fifo.read(1);
-        if( read.blockSize1 > 0 )
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+        
+        copy(buffer.data() + start1, samples, size1);
+        copy(buffer.data() + start2, samples + size1, size2);
+        
+        fifo.finishedWrite(size1 + size2);
+        
+        if( size1 + size2 < numSamples )
         {
-            t = buffers[read.startIndex1];
-            return true;
+            droppedSamples += (juce::uint64)(numSamples - size1 - size2);
+            ++numOverruns;
         }
         
-        return false;
+        return size1 + size2;
     }
     
-    int getNumAvailableForReading() const
+    struct ReadSpans
     {
-        return fifo.getNumReady();
+        const float* data1 = nullptr;
+        int size1 = 0;
+        const float* data2 = nullptr;
+        int size2 = 0;
+        
+        int getTotalSize() const { return size1 + size2; }
+    };
+    
+    //участки действительны до finishedRead
+    ReadSpans prepareToRead(int maxNumSamples) const
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(maxNumSamples, start1, size1, start2, size2);
+        
+        return { buffer.data() + start1, size1, buffer.data() + start2, size2 };
     }
+    
+    void finishedRead(int numSamples) { fifo.finishedRead(numSamples); }
+    
+    int getNumReady() const { return fifo.getNumReady(); }
+    int getCapacity() const { return fifo.getTotalSize(); }
+    
+    juce::uint64 getNumDroppedSamples() const { return droppedSamples.load(); }
+    juce::uint64 getNumOverruns() const { return numOverruns.load(); }
 private:
-    static constexpr int Capacity = 30;
-    std::array<T, Capacity> buffers;
-    juce::AbstractFifo fifo {Capacity};
-};
-
-enum Channel
-{
-    Right, //effectively 0
-    Left //effectively 1
+    static void copy(float* dest, const float* source, int numSamples)
+    {
+        if( numSamples > 0 )
+            std::memcpy(dest, source, sizeof(float) * (size_t)numSamples);
+    }
+    
+    //анализатор всегда работает во float, даже если хост обрабатывает звук в double
+    static void copy(float* dest, const double* source, int numSamples)
+    {
+        for( int i = 0; i < numSamples; ++i )
+            dest[i] = static_cast<float>(source[i]);
+    }
+    
+    std::vector<float> buffer;
+    juce::AbstractFifo fifo;
+    
+    std::atomic<juce::uint64> droppedSamples { 0 };
+    std::atomic<juce::uint64> numOverruns { 0 };
 };
 
-template<typename BlockType>
 struct SingleChannelSampleFifo
 {
+    //~0.7 с на 48 кГц: с запасом на блоки хоста любого размера и редкий таймер интерфейса
+    static constexpr int capacity = 1 << 15;
+    
     SingleChannelSampleFifo(Channel ch) : channelToUse(ch)
     {
         prepared.set(false);
     }
     
-    void update(const BlockType& buffer)
+    template<typename SampleType>
+    void update(const juce::AudioBuffer<SampleType>& buffer)
     {
         jassert(prepared.get());
-        jassert(buffer.getNumChannels() > channelToUse );
-        auto* channelPtr = buffer.getReadPointer(channelToUse);
+        jassert(buffer.getNumChannels() > 0 );
+        //на моно шине оба анализатора смотрят на единственный канал
+        auto* channelPtr = buffer.getReadPointer(juce::jmin((int)channelToUse, buffer.getNumChannels() - 1));
         
-        for( int i = 0; i < buffer.getNumSamples(); ++i )
-        {
-            pushNextSampleIntoFifo(channelPtr[i]);
-        }
+        ring.write(channelPtr, buffer.getNumSamples());
     }
 
+    //кольцо выделено заранее и не пересоздается: читатель может работать в это же время
     void prepare(int bufferSize)
     {
-        prepared.set(false);
         size.set(bufferSize);
-        
-        bufferToFill.setSize(1,             //channel
-                             bufferSize,    //num samples
-                             false,         //keepExistingContent
-                             true,          //clear extra space
-                             true);         //avoid reallocating
-        audioBufferFifo.prepare(1, bufferSize);
-        fifoIndex = 0;
         prepared.set(true);
     }
     //==============================================================================
-    int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
     bool isPrepared() const { return prepared.get(); }
     int getSize() const { return size.get(); }
     //==============================================================================
-    bool getAudioBuffer(BlockType& buf) { return audioBufferFifo.pull(buf); }
+    int getNumSamplesAvailable() const { return ring.getNumReady(); }
+    SampleRing::ReadSpans prepareToRead(int maxNumSamples) const { return ring.prepareToRead(maxNumSamples); }
+    void finishedRead(int numSamples) { ring.finishedRead(numSamples); }
+    
+    juce::uint64 getNumDroppedSamples() const { return ring.getNumDroppedSamples(); }
 private:
     Channel channelToUse;
-    int fifoIndex = 0;
-    Fifo<BlockType> audioBufferFifo;
-    BlockType bufferToFill;
+    SampleRing ring { capacity };
     juce::Atomic<bool> prepared = false;
     juce::Atomic<int> size = 0;
-    
-    void pushNextSampleIntoFifo(float sample)
-    {
-        if (fifoIndex == bufferToFill.getNumSamples())
-        {
-            auto ok = audioBufferFifo.push(bufferToFill);
-
-            juce::ignoreUnused(ok);
-            
-            fifoIndex = 0;
-        }
-        
-        bufferToFill.setSample(0, fifoIndex, sample);
-        ++fifoIndex;
-    }
 };
 
 enum Slope
@@ -152,6 +216,17 @@ enum Slope
     Slope_48
 };
 
+/**
+ пресеты анализатора: размер FFT и частота кадров.
+ */
+enum AnalyzerResolution
+{
+    AnalyzerResolution_LowCPU,      //2048, 30 кадров в секунду
+    AnalyzerResolution_Standard,    //2048, 60 кадров в секунду
+    AnalyzerResolution_Fine,        //4096
+    AnalyzerResolution_HighRes      //8192, ~5.9 Гц на бин при 48 кГц
+};
+
 struct ChainSettings
 {
     float peakFreq { 0 }, peakGainInDecibels{ 0 }, peakQuality {1.f};
@@ -160,15 +235,37 @@ struct ChainSettings
     Slope lowCutSlope { Slope::Slope_12 }, highCutSlope { Slope::Slope_12 };
     
     bool lowCutBypassed{ false }, peakBypassed{ false }, highCutBypassed{ false };
+    
+    bool linearPhase { false };
 };
 
+inline bool operator==(const ChainSettings& a, const ChainSettings& b)
+{
+    return a.peakFreq == b.peakFreq && a.peakGainInDecibels == b.peakGainInDecibels && a.peakQuality == b.peakQuality
+        && a.lowCutFreq == b.lowCutFreq && a.highCutFreq == b.highCutFreq
+        && a.lowCutSlope == b.lowCutSlope && a.highCutSlope == b.highCutSlope
+        && a.lowCutBypassed == b.lowCutBypassed && a.peakBypassed == b.peakBypassed && a.highCutBypassed == b.highCutBypassed
+        && a.linearPhase == b.linearPhase;
+}
+
+inline bool operator!=(const ChainSettings& a, const ChainSettings& b) { return !(a == b); }
+
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
 
-using Filter = juce::dsp::IIR::Filter<float>;
+/**
+ цепочка ничего не меняет: все полосы в байпасе или в нейтральном положении
+ (Peak 0 дБ, срезы на краях диапазона с наклоном 12 дБ/окт, как в настройках по умолчанию).
+ */
+bool isIdentity(const ChainSettings& chainSettings);
+
+template<typename SampleType>
+using Filter = juce::dsp::IIR::Filter<SampleType>;
 
-using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
+template<typename SampleType>
+using CutFilter = juce::dsp::ProcessorChain<Filter<SampleType>, Filter<SampleType>, Filter<SampleType>, Filter<SampleType>>;
 
-using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, CutFilter>;
+template<typename SampleType>
+using MonoChain = juce::dsp::ProcessorChain<CutFilter<SampleType>, Filter<SampleType>, CutFilter<SampleType>>;
 
 enum ChainPositions
 {
@@ -177,10 +274,128 @@ enum ChainPositions
     HighCut
 };
 
-using Coefficients = Filter::CoefficientsPtr;
-void updateCoefficients(Coefficients& old, const Coefficients& replacements);
+template<typename SampleType>
+using Coefficients = typename Filter<SampleType>::CoefficientsPtr;
+
+template<typename CoefficientsPtr>
+void updateCoefficients(CoefficientsPtr& old, const CoefficientsPtr& replacements)
+{
+    *old = *replacements;
+}
+
+/**
+ готовый набор коэффициентов всей цепочки.
+ рассчитывается вне аудиопотока и передается в processBlock через TripleBuffer.
+ */
+struct ChainCoefficients
+{
+    ChainSettings settings;
+    double sampleRate { 0 };
+    juce::uint32 version { 0 };
+    
+    std::array<BiquadCoefficients, 4> lowCut, highCut;
+    BiquadCoefficients peak;
+};
+
+ChainCoefficients makeChainCoefficients(const ChainSettings& chainSettings, double sampleRate);
+
+//раскладывает набор коэффициентов по слотам каскада с учетом байпасов и наклонов
+CascadeStages getCascadeStages(const ChainCoefficients& coefficients);
+
+/**
+ неизменяемый снимок коэффициентов, которые сейчас стоят в обработке.
+ процессор публикует новый снимок после каждого пересчета, а интерфейс забирает его по номеру версии,
+ поэтому кривая АЧХ рисуется ровно по тому, что звучит, без второго расчета фильтров.
+ старый снимок живет, пока на него есть ссылки.
+ */
+struct ChainSnapshot : juce::ReferenceCountedObject
+{
+    using Ptr = juce::ReferenceCountedObjectPtr<ChainSnapshot>;
+    
+    ChainSnapshot(const ChainCoefficients& c, juce::uint32 v) : coefficients(c), version(v) { }
+    
+    const ChainCoefficients coefficients;
+    const juce::uint32 version;
+};
+
+//те же формулы, что и в juce::dsp::FilterDesign, но без выделения памяти, их можно звать из аудиопотока
+void designPeakFilter(BiquadCoefficients& coefficients, const ChainSettings& chainSettings, double sampleRate);
+void designLowCutFilter(std::array<BiquadCoefficients, 4>& stages, const ChainSettings& chainSettings, double sampleRate);
+void designHighCutFilter(std::array<BiquadCoefficients, 4>& stages, const ChainSettings& chainSettings, double sampleRate);
+
+/**
+ плавно ведет непрерывные параметры (частоты, усиление, добротность) к новым значениям.
+ продвигается сразу на целый под-блок, поэтому коэффициенты пересчитываются не чаще раза на под-блок.
+ наклоны и байпасы переключаются сразу.
+ */
+struct ChainSmoother
+{
+    void reset(double sampleRate, double rampLengthSeconds)
+    {
+        for( auto* value : { &lowCutFreq, &highCutFreq, &peakFreq, &peakQuality } )
+            value->reset(sampleRate, rampLengthSeconds);
+        
+        peakGain.reset(sampleRate, rampLengthSeconds);
+        primed = false;
+    }
+    
+    void setTarget(const ChainSettings& chainSettings)
+    {
+        target = chainSettings;
+        
+        //самые первые значения после prepareToPlay применяем сразу
+        if( ! primed )
+        {
+            lowCutFreq.setCurrentAndTargetValue(target.lowCutFreq);
+            highCutFreq.setCurrentAndTargetValue(target.highCutFreq);
+            peakFreq.setCurrentAndTargetValue(target.peakFreq);
+            peakQuality.setCurrentAndTargetValue(target.peakQuality);
+            peakGain.setCurrentAndTargetValue(target.peakGainInDecibels);
+            primed = true;
+            return;
+        }
+        
+        lowCutFreq.setTargetValue(target.lowCutFreq);
+        highCutFreq.setTargetValue(target.highCutFreq);
+        peakFreq.setTargetValue(target.peakFreq);
+        peakQuality.setTargetValue(target.peakQuality);
+        peakGain.setTargetValue(target.peakGainInDecibels);
+    }
+    
+    bool isLowCutSmoothing() const { return lowCutFreq.isSmoothing(); }
+    bool isPeakSmoothing() const { return peakFreq.isSmoothing() || peakQuality.isSmoothing() || peakGain.isSmoothing(); }
+    bool isHighCutSmoothing() const { return highCutFreq.isSmoothing(); }
+    bool isSmoothing() const { return isLowCutSmoothing() || isPeakSmoothing() || isHighCutSmoothing(); }
+    
+    ChainSettings advance(int numSamples)
+    {
+        auto chainSettings = target;
+        
+        chainSettings.lowCutFreq = lowCutFreq.skip(numSamples);
+        chainSettings.highCutFreq = highCutFreq.skip(numSamples);
+        chainSettings.peakFreq = peakFreq.skip(numSamples);
+        chainSettings.peakQuality = peakQuality.skip(numSamples);
+        chainSettings.peakGainInDecibels = peakGain.skip(numSamples);
+        
+        return chainSettings;
+    }
+private:
+    ChainSettings target;
+    
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> lowCutFreq, highCutFreq, peakFreq, peakQuality;
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> peakGain;
+    
+    bool primed = false;
+};
 
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate);
+template<typename SampleType = float>
+Coefficients<SampleType> makePeakFilter(const ChainSettings& chainSettings, double sampleRate)
+{
+    return juce::dsp::IIR::Coefficients<SampleType>::makePeakFilter(sampleRate,
+                                                                    chainSettings.peakFreq,
+                                                                    chainSettings.peakQuality,
+                                                                    juce::Decibels::decibelsToGain((SampleType)chainSettings.peakGainInDecibels));
+}
 
 template<int Index, typename ChainType, typename CoefficientType>
 void update(ChainType& chain, const CoefficientType& coefficients)
@@ -220,23 +435,27 @@ void updateCutFilter(ChainType& chain,
     }
 }
 
-inline auto makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate )
+template<typename SampleType = float>
+auto makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate )
 {
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq,
-                                                                                       sampleRate,
-                                                                                       2 * (chainSettings.lowCutSlope + 1));
+    return juce::dsp::FilterDesign<SampleType>::designIIRHighpassHighOrderButterworthMethod((SampleType)chainSettings.lowCutFreq,
+                                                                                            sampleRate,
+                                                                                            2 * (chainSettings.lowCutSlope + 1));
 }
 
-inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate )
+template<typename SampleType = float>
+auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate )
 {
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq,
-                                                                                      sampleRate,
-                                                                                      2 * (chainSettings.highCutSlope + 1));
+    return juce::dsp::FilterDesign<SampleType>::designIIRLowpassHighOrderButterworthMethod((SampleType)chainSettings.highCutFreq,
+                                                                                           sampleRate,
+                                                                                           2 * (chainSettings.highCutSlope + 1));
 }
 //==============================================================================
 /**
 */
-class SimpleEQAudioProcessor  : public juce::AudioProcessor
+class SimpleEQAudioProcessor  : public juce::AudioProcessor,
+                                juce::AudioProcessorValueTreeState::Listener,
+                                juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -252,6 +471,9 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -275,25 +497,172 @@ public:
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
+    
+    void parameterChanged (const juce::String& parameterID, float newValue) override;
 
+    struct SmoothingStats
+    {
+        int subBlockSize;
+        juce::uint32 designsInLastBlock;
+        juce::uint64 totalDesigns;
+    };
+    
+    //сколько раз сглаживание пересчитывало коэффициенты в аудиопотоке
+    SmoothingStats getSmoothingStats() const;
+    
+    //последний опубликованный снимок коэффициентов, nullptr до первого расчета
+    ChainSnapshot::Ptr getChainSnapshot() const;
+    //дешевая проверка без захвата ссылки: 0, пока снимков не было
+    juce::uint32 getChainSnapshotVersion() const { return chainSnapshotVersion.load(); }
+    
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
     
-    using BlockType = juce::AudioBuffer<float>;
-    SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
-    SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right };
+    SingleChannelSampleFifo leftChannelFifo { Channel::Left };
+    SingleChannelSampleFifo rightChannelFifo { Channel::Right };
 private:
-    MonoChain leftChain, rightChain;
+    //каналы считаются группами по ширине SIMD регистра, коэффициенты у всех групп общие.
+    //готовится только тот набор, чью точность выбрал хост
+    std::vector<SIMDBiquadCascade<float>> floatCascades;
+    std::vector<SIMDBiquadCascade<double>> doubleCascades;
     
-    void updatePeakFilter(const ChainSettings& chainSettings);
-
+    template<typename SampleType>
+    std::vector<SIMDBiquadCascade<SampleType>>& getCascades();
+    
+    /**
+     фоновый поток, который пересчитывает коэффициенты только когда изменились параметры.
+     */
+    struct FilterDesignThread : juce::Thread
+    {
+        FilterDesignThread(SimpleEQAudioProcessor& p) : juce::Thread("SimpleEQ Filter Design"), processor(p) { }
+        void run() override;
+        
+        //задержка реакции на автоматизацию, на фоне сглаживания коэффициентов незаметна
+        static constexpr int designPollMs = 10;
+    private:
+        SimpleEQAudioProcessor& processor;
+    };
+    
+    FilterDesignThread filterDesignThread { *this };
+    juce::CriticalSection designLock;
+    TripleBuffer<ChainCoefficients> chainCoefficients;
+    
+    std::atomic<juce::uint32> parametersVersion { 1 };
+    std::atomic<double> designSampleRate { 0 };
+    
+    juce::uint32 designedVersion { 0 };
+    ChainSettings designedSettings;
+    double designedSampleRate { 0 };
+    
+    //снимок для интерфейса, пишется только из designFilters()
+    juce::SpinLock snapshotLock;
+    ChainSnapshot::Ptr chainSnapshot;
+    std::atomic<juce::uint32> chainSnapshotVersion { 0 };
+    
+    void designFilters();
+    void publishSnapshot(const ChainCoefficients& coefficients);
+    //switchModeImmediately: сменить режим без прогрева и перехода, когда на выходе все равно тишина
+    void applyPendingCoefficients(bool switchModeImmediately);
+    void applyCoefficients(const ChainCoefficients& coefficients);
+    void resetCascades();
+    
+    template<typename SampleType>
+    void processSamples(juce::AudioBuffer<SampleType>& buffer);
+    template<typename SampleType>
+    void processCascades(const juce::dsp::AudioBlock<SampleType>& block);
+    template<typename SampleType>
+    void processSmoothed(const juce::dsp::AudioBlock<SampleType>& block);
+    template<typename SampleType>
+    void processFilters(const juce::dsp::AudioBlock<SampleType>& block);
+    template<typename SampleType>
+    void processCrossfaded(const juce::dsp::AudioBlock<SampleType>& block);
+    template<typename SampleType>
+    void primeLinearPhase(const juce::dsp::AudioBlock<SampleType>& block);
+    template<typename SampleType>
+    void primeFilters(const juce::dsp::AudioBlock<SampleType>& block);
+    template<typename SampleType>
+    void processModeCrossfade(const juce::dsp::AudioBlock<SampleType>& block);
+    template<typename SampleType>
+    void delayFilters(const juce::dsp::AudioBlock<SampleType>& block, bool replaceWithDelayed);
+    
+    /**
+     приостановка на тишине: когда вход тихий, а состояние фильтров затухло ниже порога,
+     цепочки и анализатор не считаются, пока на входе снова не появится сигнал.
+     */
+    static constexpr float silenceThreshold = 1.0e-6f; //-120 дБ
+    
+    bool suspended = false;
+    juce::int64 silentSamples = 0;
+    
+    //хвост по текущим настройкам, считается в потоке расчета коэффициентов
+    std::atomic<double> tailLengthSeconds { 0 };
+    
+    template<typename SampleType>
+    static bool isSilent(const juce::AudioBuffer<SampleType>& buffer, int numChannels);
+    template<typename SampleType>
+    static int findFirstAudibleSample(const juce::AudioBuffer<SampleType>& buffer, int numChannels);
+    bool hasChainDecayed() const;
+    
+    //сглаживание автоматизации: коэффициенты пересчитываются раз в под-блок, а не раз в блок хоста
+    static constexpr int smoothingSubBlockSize = 32;
+    static constexpr double smoothingRampSeconds = 0.05;
+    
+    //быстрый путь: если цепочка тождественна, фильтры не считаются вовсе.
+    //вход и выход из этого состояния - короткий переход между сухим и обработанным сигналом
+    static constexpr double identityCrossfadeSeconds = 0.01;
+    
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> filtersGain;
+    juce::AudioBuffer<float> dryFloat;
+    juce::AudioBuffer<double> dryDouble;
+    std::vector<float> crossfadeGains;
+    
+    template<typename SampleType>
+    juce::AudioBuffer<SampleType>& getDryBuffer();
+    
+    ChainSmoother chainSmoother;
+    ChainCoefficients smoothedCoefficients;
+    std::atomic<juce::uint32> smoothingDesignsInLastBlock { 0 };
+    std::atomic<juce::uint64> smoothingDesignsTotal { 0 };
+    
+    /**
+     линейно-фазовый режим: ядро КИХ строится в потоке расчета вместе с коэффициентами
+     и передается свертке через свой TripleBuffer. задержку хосту сообщает аудиопоток,
+     когда режим действительно сменился (см. updateReportedLatency).
+     */
+    LinearPhaseDesigner linearPhaseDesigner;
+    TripleBuffer<LinearPhaseKernel> linearPhaseKernels;
+    PartitionedConvolver linearPhaseConvolver;
+    bool linearPhaseActive = false;
+    
+    /**
+     смена режима без щелчка. сначала новый путь прогревается на копии входа, пока слышен старый:
+     свертка - на длину ядра, каскады - на длину задержки свертки. затем одну часть свертки
+     оба пути считаются вместе и линейно переходят от старого к новому.
+     на переходе выход каскадов идет через линию задержки filtersDelay, чтобы совпасть со сверткой
+     по времени, иначе сумма двух сдвинутых копий дает гребенчатый фильтр.
+     linearPhaseActive во время перехода - это режим, в который переходим, а во время прогрева - текущий.
+     */
+    static constexpr int modeCrossfadeLength = LinearPhaseDesigner::partitionSize;
+    int modePrimingSamples = 0;
+    int modeCrossfadeSamples = 0;
     
+    int linearPhaseLatency = 0;
+    juce::AudioBuffer<float> filtersDelayFloat;
+    juce::AudioBuffer<double> filtersDelayDouble;
+    int filtersDelayPosition = 0;
     
+    template<typename SampleType>
+    juce::AudioBuffer<SampleType>& getFiltersDelay();
     
-    void updateLowCutFilters(const ChainSettings& chainSettings);
-    void updateHighCutFilters(const ChainSettings& chainSettings);
+    /**
+     setLatencySamples нельзя звать из аудиопотока, поэтому он только запоминает новую задержку,
+     а хосту ее передает handleAsyncUpdate в потоке сообщений.
+     */
+    int reportedLatency = 0;
+    std::atomic<int> pendingLatencySamples { 0 };
     
-    void updateFilters();
+    void updateReportedLatency();
+    void handleAsyncUpdate() override;
     
     juce::dsp::Oscillator<float> osc;
     //==============================================================================
@@ -0,0 +1,181 @@
+/*
+  ==============================================================================
+
+    АЧХ цепочки для кривой в интерфейсе: по столбцу пикселей на точку,
+    все ступени сразу в SIMD и отдельный кеш для каждой полосы.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <vector>
+
+#include "BiquadCascade.h"
+
+/**
+ для каждого столбца заранее посчитаны cos(w) и cos(2w), тогда |H|^2 биквада - отношение
+ двух многочленов от них, без комплексной арифметики, exp и pow (та же формула, что в LinearPhaseDesigner).
+ полосы LowCut, Peak и HighCut хранят свои массивы дБ, а кривая - их сумма,
+ поэтому при движении одной полосы пересчитывается только она.
+ */
+struct ResponseEvaluator
+{
+    using SIMDType = juce::dsp::SIMDRegister<double>;
+    static constexpr int numLanes = (int)SIMDType::SIMDNumElements;
+
+    enum Band
+    {
+        lowCutBand,
+        peakBand,
+        highCutBand,
+        numBands
+    };
+
+    /**
+     столбцы от 20 Гц до 20 кГц по логарифмической шкале, как у сетки.
+     таблицы пересчитываются, только если изменилась ширина или частота дискретизации.
+     */
+    void prepare(int numColumnsToUse, double sampleRateToUse)
+    {
+        if( numColumnsToUse == numColumns && sampleRateToUse == sampleRate )
+            return;
+
+        numColumns = numColumnsToUse;
+        sampleRate = sampleRateToUse;
+
+        const auto numRegisters = (numColumns + numLanes - 1) / numLanes;
+        cos1.assign((size_t)numRegisters, SIMDType::expand(1.0));
+        cos2.assign((size_t)numRegisters, SIMDType::expand(1.0));
+
+        for( int column = 0; column < numColumns; ++column )
+        {
+            const auto freq = juce::mapToLog10(double(column) / double(numColumns), 20.0, 20000.0);
+            const auto omega = juce::MathConstants<double>::twoPi * freq / sampleRate;
+
+            cos1[(size_t)(column / numLanes)].set((size_t)(column % numLanes), std::cos(omega));
+            cos2[(size_t)(column / numLanes)].set((size_t)(column % numLanes), std::cos(2.0 * omega));
+        }
+
+        for( auto& band : bands )
+        {
+            band.decibels.assign((size_t)numColumns, 0.0);
+            band.numStages = -1;
+        }
+
+        decibels.assign((size_t)numColumns, 0.0);
+    }
+
+    /**
+     ступени одной полосы, nullptr - выключенная ступень.
+     если коэффициенты те же, что в прошлый раз, полоса не пересчитывается.
+     */
+    void setBand(Band bandIndex, const BiquadCoefficients* const* stages, int numStagesToUse)
+    {
+        jassert(numStagesToUse <= maxStagesPerBand);
+
+        BandCache next;
+        for( int i = 0; i < numStagesToUse; ++i )
+        {
+            if( stages[i] != nullptr )
+                next.stages[(size_t)next.numStages++] = *stages[i];
+        }
+
+        auto& band = bands[(size_t)bandIndex];
+
+        if( next.numStages == band.numStages
+            && std::equal(next.stages.begin(), next.stages.begin() + next.numStages, band.stages.begin()) )
+            return;
+
+        band.stages = next.stages;
+        band.numStages = next.numStages;
+        evaluate(band);
+
+        needsSum = true;
+    }
+
+    //кривая в дБ по столбцам, сумма всех полос
+    const std::vector<double>& getDecibels()
+    {
+        if( needsSum )
+        {
+            std::fill(decibels.begin(), decibels.end(), 0.0);
+
+            for( auto& band : bands )
+            {
+                for( size_t i = 0; i < decibels.size(); ++i )
+                    decibels[i] += band.decibels[i];
+            }
+
+            needsSum = false;
+        }
+
+        return decibels;
+    }
+private:
+    static constexpr int maxStagesPerBand = 4;
+
+    struct BandCache
+    {
+        std::array<BiquadCoefficients, maxStagesPerBand> stages;
+        int numStages = 0;
+        std::vector<double> decibels;
+    };
+
+    void evaluate(BandCache& band)
+    {
+        if( band.numStages == 0 )
+        {
+            std::fill(band.decibels.begin(), band.decibels.end(), 0.0);
+            return;
+        }
+
+        //|H|^2 = (n0 + n1 cos w + n2 cos 2w) / (d0 + d1 cos w + d2 cos 2w)
+        std::array<std::array<double, 6>, maxStagesPerBand> terms;
+        for( int s = 0; s < band.numStages; ++s )
+        {
+            const auto& c = band.stages[(size_t)s];
+            const auto b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+
+            terms[(size_t)s] = { b0 * b0 + b1 * b1 + b2 * b2, 2.0 * (b0 * b1 + b1 * b2), 2.0 * b0 * b2,
+                                 1.0 + a1 * a1 + a2 * a2, 2.0 * (a1 + a1 * a2), 2.0 * a2 };
+        }
+
+        for( size_t r = 0; r < cos1.size(); ++r )
+        {
+            auto numerator = SIMDType::expand(1.0);
+            auto denominator = SIMDType::expand(1.0);
+
+            for( int s = 0; s < band.numStages; ++s )
+            {
+                const auto& t = terms[(size_t)s];
+                numerator *= SIMDType::expand(t[0]) + cos1[r] * t[1] + cos2[r] * t[2];
+                denominator *= SIMDType::expand(t[3]) + cos1[r] * t[4] + cos2[r] * t[5];
+            }
+
+            //деления в SIMDRegister нет, логарифм все равно скалярный
+            for( size_t lane = 0; lane < (size_t)numLanes; ++lane )
+            {
+                const auto column = r * (size_t)numLanes + lane;
+                if( column >= band.decibels.size() )
+                    break;
+
+                //как у gainToDecibels: не ниже -100 дБ
+                const auto magnitudeSquared = juce::jmax(1.0e-10, numerator.get(lane) / denominator.get(lane));
+                band.decibels[column] = 10.0 * std::log10(magnitudeSquared);
+            }
+        }
+    }
+
+    int numColumns = 0;
+    double sampleRate = 0;
+
+    std::vector<SIMDType> cos1, cos2;
+    std::array<BandCache, numBands> bands;
+
+    std::vector<double> decibels;
+    bool needsSum = true;
+};
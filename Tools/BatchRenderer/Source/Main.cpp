@@ -0,0 +1,278 @@
+/*
+  ==============================================================================
+
+    Консольный рендер: прогоняет аудиофайлы через SimpleEQ с фиксированными
+    настройками, без DAW и быстрее реального времени.
+
+    SimpleEQBatchRenderer [--state=файл] [--preset=файл.xml] [--out=папка]
+                          [--threads=N] [--block=N] файл1.wav файл2.flac ...
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+
+#include <iostream>
+
+struct RenderSettings
+{
+    juce::MemoryBlock state;
+    juce::File outputDirectory;
+    int blockSize = 8192;
+    int numThreads = juce::SystemStats::getNumCpus();
+};
+
+struct RenderTotals
+{
+    void add(const juce::String& line, double audioSeconds, double wallSeconds)
+    {
+        const juce::ScopedLock sl(lock);
+        std::cout << line << std::endl;
+        totalAudioSeconds += audioSeconds;
+        totalWallSeconds += wallSeconds;
+        ++numFilesDone;
+    }
+
+    void fail(const juce::String& message)
+    {
+        const juce::ScopedLock sl(lock);
+        std::cerr << message << std::endl;
+        ++numFilesFailed;
+    }
+
+    juce::CriticalSection lock;
+    double totalAudioSeconds = 0, totalWallSeconds = 0;
+    int numFilesDone = 0, numFilesFailed = 0;
+};
+
+/**
+ один файл - один экземпляр процессора, поэтому файлы можно рендерить параллельно.
+ */
+struct RenderJob : juce::ThreadPoolJob
+{
+    RenderJob(const juce::File& file, const RenderSettings& s, RenderTotals& t) :
+    juce::ThreadPoolJob(file.getFileName()),
+    inputFile(file),
+    settings(s),
+    totals(t)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor(inputFile));
+        if( reader == nullptr )
+        {
+            totals.fail("can't read " + inputFile.getFullPathName());
+            return jobHasFinished;
+        }
+
+        const auto numChannels = (int)reader->numChannels;
+        const auto sampleRate = reader->sampleRate;
+        const auto blockSize = settings.blockSize;
+
+        SimpleEQAudioProcessor processor;
+
+        if( settings.state.getSize() > 0 )
+            processor.setStateInformation(settings.state.getData(), (int)settings.state.getSize());
+
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+        layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+
+        if( ! processor.setBusesLayout(layout) )
+        {
+            totals.fail("unsupported channel layout in " + inputFile.getFullPathName());
+            return jobHasFinished;
+        }
+
+        //в оффлайне коэффициенты считаются прямо в processBlock, без фонового потока
+        processor.setNonRealtime(true);
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        auto outputFile = settings.outputDirectory.getChildFile(inputFile.getFileName());
+        
+        //createWriter сначала удаляет файл, так что с --out в папку исходников мы бы стерли вход
+        if( outputFile == inputFile )
+        {
+            totals.fail("output would overwrite the input " + inputFile.getFullPathName() + ", choose another --out");
+            return jobHasFinished;
+        }
+        
+        auto writer = createWriter(formatManager, outputFile, *reader);
+        if( writer == nullptr )
+        {
+            totals.fail("can't write " + outputFile.getFullPathName());
+            return jobHasFinished;
+        }
+
+        juce::AudioBuffer<float> buffer(numChannels, blockSize);
+        juce::MidiBuffer midi;
+
+        //задержка линейно-фазового режима срезается в начале, а за концом файла дочитываем нули,
+        //чтобы вышли задержанный сигнал и хвост фильтров. оба значения известны после prepareToPlay
+        const auto latencySamples = (juce::int64)processor.getLatencySamples();
+        const auto tailSamples = (juce::int64)std::ceil(processor.getTailLengthSeconds() * sampleRate);
+        const auto totalSamples = reader->lengthInSamples + latencySamples + tailSamples;
+        auto samplesToSkip = latencySamples;
+
+        for( juce::int64 position = 0; position < totalSamples; position += blockSize )
+        {
+            if( shouldExit() )
+                break;
+
+            const auto numSamples = (int)juce::jmin((juce::int64)blockSize, totalSamples - position);
+            buffer.setSize(numChannels, numSamples, false, false, true);
+
+            //за концом файла read заполняет буфер нулями
+            reader->read(&buffer, 0, numSamples, position, true, true);
+            processor.processBlock(buffer, midi);
+
+            const auto numToSkip = (int)juce::jmin(samplesToSkip, (juce::int64)numSamples);
+            samplesToSkip -= numToSkip;
+            writer->writeFromAudioSampleBuffer(buffer, numToSkip, numSamples - numToSkip);
+        }
+
+        processor.releaseResources();
+        writer.reset();
+
+        const auto wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        const auto audioSeconds = (double)reader->lengthInSamples / sampleRate;
+
+        juce::String line;
+        line << inputFile.getFileName() << ": " << juce::String(audioSeconds, 1) << " s of audio in "
+             << juce::String(wallSeconds, 2) << " s (x" << juce::String(audioSeconds / juce::jmax(wallSeconds, 1e-9), 1) << " realtime)";
+        totals.add(line, audioSeconds, wallSeconds);
+
+        return jobHasFinished;
+    }
+private:
+    juce::File inputFile;
+    const RenderSettings& settings;
+    RenderTotals& totals;
+
+    static std::unique_ptr<juce::AudioFormatWriter> createWriter(juce::AudioFormatManager& formatManager,
+                                                                 const juce::File& outputFile,
+                                                                 const juce::AudioFormatReader& reader)
+    {
+        auto* format = formatManager.findFormatForFileExtension(outputFile.getFileExtension());
+        if( format == nullptr )
+            return {};
+
+        outputFile.deleteFile();
+
+        //FLAC не умеет 32 бита, поэтому при отказе пробуем 24
+        for( auto bitsPerSample : { (int)reader.bitsPerSample, 24 } )
+        {
+            std::unique_ptr<juce::FileOutputStream> stream (outputFile.createOutputStream());
+            if( stream == nullptr )
+                return {};
+
+            std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor(stream.get(),
+                                                                                     reader.sampleRate,
+                                                                                     reader.numChannels,
+                                                                                     bitsPerSample,
+                                                                                     reader.metadataValues,
+                                                                                     0));
+            if( writer != nullptr )
+            {
+                stream.release(); //теперь потоком владеет writer
+                return writer;
+            }
+
+            stream.reset();
+            outputFile.deleteFile();
+        }
+
+        return {};
+    }
+};
+
+static juce::MemoryBlock loadState(const juce::File& stateFile, const juce::File& presetFile)
+{
+    juce::MemoryBlock state;
+
+    //бинарный блок в том виде, в каком его пишет getStateInformation
+    if( stateFile != juce::File() )
+        stateFile.loadFileAsData(state);
+
+    //или пресет в виде XML дерева параметров
+    if( presetFile != juce::File() )
+    {
+        if( auto xml = juce::XmlDocument::parse(presetFile) )
+        {
+            juce::MemoryOutputStream mos(state, false);
+            juce::ValueTree::fromXml(*xml).writeToStream(mos);
+        }
+    }
+
+    return state;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    RenderSettings settings;
+
+    auto getFileOption = [&args](const juce::String& option)
+    {
+        return args.containsOption(option) ? args.getExistingFileForOption(option) : juce::File();
+    };
+
+    settings.state = loadState(getFileOption("--state"), getFileOption("--preset"));
+    settings.outputDirectory = args.containsOption("--out") ? args.getFileForOption("--out")
+                                                            : juce::File::getCurrentWorkingDirectory().getChildFile("rendered");
+
+    if( args.containsOption("--block") )
+        settings.blockSize = juce::jmax(16, args.getValueForOption("--block").getIntValue());
+
+    if( args.containsOption("--threads") )
+        settings.numThreads = juce::jmax(1, args.getValueForOption("--threads").getIntValue());
+
+    juce::Array<juce::File> inputFiles;
+    for( auto& arg : args.arguments )
+    {
+        if( ! arg.isOption() )
+            inputFiles.add(arg.resolveAsExistingFile());
+    }
+
+    if( inputFiles.isEmpty() )
+    {
+        std::cout << "usage: SimpleEQBatchRenderer [--state=file] [--preset=file.xml] [--out=dir] "
+                     "[--threads=N] [--block=N] input1.wav input2.flac ..." << std::endl;
+        return 1;
+    }
+
+    settings.outputDirectory.createDirectory();
+
+    RenderTotals totals;
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    {
+        juce::ThreadPool pool(settings.numThreads);
+
+        for( auto& file : inputFiles )
+            pool.addJob(new RenderJob(file, settings, totals), true);
+
+        while( pool.getNumJobs() > 0 )
+            juce::Thread::sleep(50);
+    }
+
+    const auto wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+    std::cout << totals.numFilesDone << " files, " << juce::String(totals.totalAudioSeconds, 1) << " s of audio in "
+              << juce::String(wallSeconds, 2) << " s on " << settings.numThreads << " threads (x"
+              << juce::String(totals.totalAudioSeconds / juce::jmax(wallSeconds, 1e-9), 1) << " realtime)" << std::endl;
+
+    return totals.numFilesFailed > 0 ? 1 : 0;
+}
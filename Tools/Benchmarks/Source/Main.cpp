@@ -0,0 +1,617 @@
+/*
+  ==============================================================================
+
+    Микробенчмарк фильтров: processBlock целиком, старая цепочка MonoChain
+    и голый SIMDBiquadCascade на разных размерах блока, частотах дискретизации,
+    наклонах и байпасах. Отдельно - перевод спектра анализатора в дБ на каждом FFTOrder.
+    Каждый замер - одна строка JSON (или CSV), чтобы результаты можно было
+    сравнивать между сборками.
+
+    SimpleEQBenchmarks [--targets=processor,chain,cascade,decibels] [--precision=float,double]
+                       [--rates=44100,48000,...] [--blocks=16,32,...] [--samples=N]
+                       [--repeats=N] [--format=json|csv] [--quick]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/DecibelKernel.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+//==============================================================================
+//считаем выделения памяти только в потоке, который гоняет замеры (в нем же идет processBlock).
+//фоновый поток расчета коэффициентов выделяет память под ChainSnapshot на каждый пересчет,
+//и это не должно попадать в замер аудиопути
+static std::atomic<juce::uint64> numAllocations { 0 };
+static thread_local bool isMeasuringThread = false;
+
+static void* allocate(std::size_t size)
+{
+    if( isMeasuringThread )
+        ++numAllocations;
+
+    if( auto* ptr = std::malloc(size > 0 ? size : 1) )
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+static void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+    if( isMeasuringThread )
+        ++numAllocations;
+
+    const auto align = static_cast<std::size_t>(alignment);
+    const auto roundedSize = ((size > 0 ? size : 1) + align - 1) / align * align;
+
+   #if JUCE_MSVC
+    if( auto* ptr = _aligned_malloc(roundedSize, align) )
+   #else
+    if( auto* ptr = std::aligned_alloc(align, roundedSize) )
+   #endif
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+static void freeAligned(void* ptr)
+{
+   #if JUCE_MSVC
+    _aligned_free(ptr);
+   #else
+    std::free(ptr);
+   #endif
+}
+
+void* operator new(std::size_t size)                                { return allocate(size); }
+void* operator new[](std::size_t size)                              { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment)    { return allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment)  { return allocateAligned(size, alignment); }
+
+void operator delete(void* ptr) noexcept                                        { std::free(ptr); }
+void operator delete[](void* ptr) noexcept                                      { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept                           { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept                         { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept                      { freeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept                    { freeAligned(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept         { freeAligned(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept       { freeAligned(ptr); }
+
+//==============================================================================
+//счетчик тактов процессора (на x86 это опорные такты TSC). там, где его нет, пишем 0
+static juce::uint64 readCycleCounter()
+{
+   #if JUCE_INTEL
+    return (juce::uint64)__rdtsc();
+   #else
+    return 0;
+   #endif
+}
+
+static constexpr int numChannels = 2;
+
+struct BenchmarkOptions
+{
+    juce::StringArray targets { "processor", "chain", "cascade", "decibels" };
+    juce::StringArray precisions { "float", "double" };
+    juce::Array<double> sampleRates { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+    juce::Array<int> blockSizes { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    int samplesPerRun = 1 << 16;
+    int numRepeats = 5;
+    bool csv = false;
+};
+
+struct BenchmarkCase
+{
+    juce::String target;
+    bool useDouble = false;
+    double sampleRate = 48000.0;
+    int blockSize = 512;
+    ChainSettings settings;
+};
+
+struct BenchmarkResult
+{
+    double nsPerSample = 0;
+    double cyclesPerSample = 0;
+    juce::uint64 allocations = 0;
+};
+
+/**
+ прогоняет один и тот же шум через processFunction несколько раз и берет лучший проход.
+ копирование шума в рабочий буфер не входит в замер.
+ */
+template<typename SampleType, typename ProcessFunction>
+BenchmarkResult measure(const BenchmarkCase& benchmarkCase,
+                        const BenchmarkOptions& options,
+                        ProcessFunction&& processFunction)
+{
+    const auto blockSize = benchmarkCase.blockSize;
+    const auto numSamples = juce::jmax(blockSize, (options.samplesPerRun + blockSize - 1) / blockSize * blockSize);
+
+    juce::AudioBuffer<SampleType> noise(numChannels, numSamples), work(numChannels, numSamples);
+
+    juce::Random random(0x5eed);
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        for( int i = 0; i < numSamples; ++i )
+            noise.setSample(ch, i, (SampleType)(random.nextFloat() * 0.5f - 0.25f));
+    }
+
+    auto runOnce = [&]()
+    {
+        std::array<SampleType*, numChannels> channels;
+
+        for( int start = 0; start < numSamples; start += blockSize )
+        {
+            for( int ch = 0; ch < numChannels; ++ch )
+                channels[ch] = work.getWritePointer(ch, start);
+
+            processFunction(channels.data(), blockSize);
+        }
+    };
+
+    //прогрев: кэши, предсказатель переходов, первое применение коэффициентов
+    work.makeCopyOf(noise, true);
+    runOnce();
+
+    BenchmarkResult best;
+    best.nsPerSample = std::numeric_limits<double>::max();
+
+    for( int repeat = 0; repeat < options.numRepeats; ++repeat )
+    {
+        work.makeCopyOf(noise, true);
+
+        const auto allocationsBefore = numAllocations.load();
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+        const auto startCycles = readCycleCounter();
+
+        runOnce();
+
+        const auto cycles = readCycleCounter() - startCycles;
+        const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        const auto allocations = numAllocations.load() - allocationsBefore;
+
+        const auto nsPerSample = seconds * 1.0e9 / numSamples;
+        if( nsPerSample < best.nsPerSample )
+        {
+            best.nsPerSample = nsPerSample;
+            best.cyclesPerSample = (double)cycles / numSamples;
+        }
+
+        //выделения памяти - худший проход, а не лучший
+        best.allocations = juce::jmax(best.allocations, allocations);
+    }
+
+    return best;
+}
+
+static void setParameter(juce::AudioProcessorValueTreeState& apvts, const juce::String& parameterID, float value)
+{
+    if( auto* parameter = apvts.getParameter(parameterID) )
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+template<typename SampleType>
+BenchmarkResult runProcessor(SimpleEQAudioProcessor& processor, const BenchmarkCase& benchmarkCase, const BenchmarkOptions& options)
+{
+    auto& apvts = processor.apvts;
+    const auto& settings = benchmarkCase.settings;
+
+    setParameter(apvts, "LowCut Freq", settings.lowCutFreq);
+    setParameter(apvts, "HighCut Freq", settings.highCutFreq);
+    setParameter(apvts, "Peak Freq", settings.peakFreq);
+    setParameter(apvts, "Peak Gain", settings.peakGainInDecibels);
+    setParameter(apvts, "Peak Quality", settings.peakQuality);
+    setParameter(apvts, "LowCut Slope", (float)settings.lowCutSlope);
+    setParameter(apvts, "HighCut Slope", (float)settings.highCutSlope);
+    setParameter(apvts, "LowCut Bypassed", settings.lowCutBypassed ? 1.f : 0.f);
+    setParameter(apvts, "Peak Bypassed", settings.peakBypassed ? 1.f : 0.f);
+    setParameter(apvts, "HighCut Bypassed", settings.highCutBypassed ? 1.f : 0.f);
+
+    //prepareToPlay рассчитывает и применяет коэффициенты синхронно, поэтому в замер не попадет сглаживание
+    processor.setProcessingPrecision(std::is_same_v<SampleType, double> ? juce::AudioProcessor::doublePrecision
+                                                                       : juce::AudioProcessor::singlePrecision);
+    processor.setRateAndBufferSizeDetails(benchmarkCase.sampleRate, benchmarkCase.blockSize);
+    processor.prepareToPlay(benchmarkCase.sampleRate, benchmarkCase.blockSize);
+
+    juce::MidiBuffer midi;
+
+    auto result = measure<SampleType>(benchmarkCase, options, [&](SampleType* const* channels, int numSamples)
+    {
+        juce::AudioBuffer<SampleType> buffer(channels, numChannels, numSamples);
+        processor.processBlock(buffer, midi);
+    });
+
+    processor.releaseResources();
+    return result;
+}
+
+template<typename SampleType>
+BenchmarkResult runChain(const BenchmarkCase& benchmarkCase, const BenchmarkOptions& options)
+{
+    const auto& settings = benchmarkCase.settings;
+    const auto sampleRate = benchmarkCase.sampleRate;
+
+    //так фильтровал processBlock до перехода на SIMDBiquadCascade: по цепочке на канал
+    std::array<MonoChain<SampleType>, numChannels> chains;
+
+    juce::dsp::ProcessSpec spec;
+    spec.sampleRate = sampleRate;
+    spec.maximumBlockSize = (juce::uint32)benchmarkCase.blockSize;
+    spec.numChannels = 1;
+
+    auto peakCoefficients = makePeakFilter<SampleType>(settings, sampleRate);
+    auto lowCutCoefficients = makeLowCutFilter<SampleType>(settings, sampleRate);
+    auto highCutCoefficients = makeHighCutFilter<SampleType>(settings, sampleRate);
+
+    for( auto& chain : chains )
+    {
+        chain.prepare(spec);
+
+        chain.template setBypassed<ChainPositions::LowCut>(settings.lowCutBypassed);
+        chain.template setBypassed<ChainPositions::Peak>(settings.peakBypassed);
+        chain.template setBypassed<ChainPositions::HighCut>(settings.highCutBypassed);
+
+        updateCoefficients(chain.template get<ChainPositions::Peak>().coefficients, peakCoefficients);
+        updateCutFilter(chain.template get<ChainPositions::LowCut>(), lowCutCoefficients, settings.lowCutSlope);
+        updateCutFilter(chain.template get<ChainPositions::HighCut>(), highCutCoefficients, settings.highCutSlope);
+    }
+
+    return measure<SampleType>(benchmarkCase, options, [&](SampleType* const* channels, int numSamples)
+    {
+        juce::ScopedNoDenormals noDenormals;
+        juce::dsp::AudioBlock<SampleType> block(channels, numChannels, (size_t)numSamples);
+
+        for( int ch = 0; ch < numChannels; ++ch )
+        {
+            auto channelBlock = block.getSingleChannelBlock((size_t)ch);
+            chains[ch].process(juce::dsp::ProcessContextReplacing<SampleType>(channelBlock));
+        }
+    });
+}
+
+template<typename SampleType>
+BenchmarkResult runCascade(const BenchmarkCase& benchmarkCase, const BenchmarkOptions& options)
+{
+    jassert(numChannels <= SIMDBiquadCascade<SampleType>::getMaxNumChannels());
+
+    SIMDBiquadCascade<SampleType> cascade;
+    cascade.prepare(benchmarkCase.blockSize);
+
+    const auto coefficients = makeChainCoefficients(benchmarkCase.settings, benchmarkCase.sampleRate);
+    cascade.setStages(getCascadeStages(coefficients));
+
+    return measure<SampleType>(benchmarkCase, options, [&](SampleType* const* channels, int numSamples)
+    {
+        juce::ScopedNoDenormals noDenormals;
+        cascade.process(juce::dsp::AudioBlock<SampleType>(channels, numChannels, (size_t)numSamples));
+    });
+}
+
+template<typename SampleType>
+BenchmarkResult run(SimpleEQAudioProcessor& processor, const BenchmarkCase& benchmarkCase, const BenchmarkOptions& options)
+{
+    if( benchmarkCase.target == "processor" )
+        return runProcessor<SampleType>(processor, benchmarkCase, options);
+
+    if( benchmarkCase.target == "chain" )
+        return runChain<SampleType>(benchmarkCase, options);
+
+    return runCascade<SampleType>(benchmarkCase, options);
+}
+
+//==============================================================================
+/**
+ numFrames раз вызывает processFrame и берет лучший проход; результат - на один бин.
+ */
+template<typename ProcessFunction>
+BenchmarkResult measureBins(int numBins, int numFrames, const BenchmarkOptions& options, ProcessFunction&& processFrame)
+{
+    processFrame();
+
+    BenchmarkResult best;
+    best.nsPerSample = std::numeric_limits<double>::max();
+
+    for( int repeat = 0; repeat < options.numRepeats; ++repeat )
+    {
+        const auto allocationsBefore = numAllocations.load();
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+        const auto startCycles = readCycleCounter();
+
+        for( int frame = 0; frame < numFrames; ++frame )
+            processFrame();
+
+        const auto cycles = readCycleCounter() - startCycles;
+        const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        const auto numValues = (double)numBins * numFrames;
+
+        if( seconds * 1.0e9 / numValues < best.nsPerSample )
+        {
+            best.nsPerSample = seconds * 1.0e9 / numValues;
+            best.cyclesPerSample = (double)cycles / numValues;
+        }
+
+        best.allocations = juce::jmax(best.allocations, numAllocations.load() - allocationsBefore);
+    }
+
+    return best;
+}
+
+/**
+ перевод спектра в дБ на каждом FFTOrder: прежний путь FFTDataGenerator
+ (очистка 2 * fftSize, isinf/isnan с делением, gainToDecibels) против powerToDecibels.
+ оба варианта сначала копируют спектр в рабочий буфер, как это делал бы FFT.
+ */
+static void runDecibels(const BenchmarkOptions& options)
+{
+    constexpr float negativeInfinity = -48.f;
+
+    for( int order = 11; order <= 13; ++order )
+    {
+        const auto fftSize = 1 << order;
+        const auto numBins = fftSize / 2;
+        const auto numFrames = juce::jmax(1, options.samplesPerRun / numBins);
+
+        //уровни от -70 до +10 дБ, чтобы часть бинов уходила под negativeInfinity
+        std::vector<float> magnitudes((size_t)numBins), power((size_t)numBins);
+        juce::Random random(0x5eed);
+        for( size_t k = 0; k < magnitudes.size(); ++k )
+        {
+            magnitudes[k] = (float)numBins * std::pow(10.f, random.nextFloat() * 4.f - 3.5f);
+            power[k] = magnitudes[k] * magnitudes[k];
+        }
+
+        std::vector<float> referenceData((size_t)(2 * fftSize)), kernelData((size_t)numBins);
+
+        auto reference = [&]()
+        {
+            referenceData.assign(referenceData.size(), 0);
+            std::copy(magnitudes.begin(), magnitudes.end(), referenceData.begin());
+
+            for( int i = 0; i < numBins; ++i )
+            {
+                auto v = referenceData[(size_t)i];
+                v = ( !std::isinf(v) && !std::isnan(v) ) ? v / float(numBins) : 0.f;
+                referenceData[(size_t)i] = v;
+            }
+
+            for( int i = 0; i < numBins; ++i )
+                referenceData[(size_t)i] = juce::Decibels::gainToDecibels(referenceData[(size_t)i], negativeInfinity);
+        };
+
+        auto kernel = [&]()
+        {
+            std::copy(power.begin(), power.end(), kernelData.begin());
+
+            const auto normalisation = 1.f / float(numBins);
+            powerToDecibels(kernelData.data(), kernelData.data(), numBins, normalisation * normalisation, negativeInfinity);
+        };
+
+        const auto referenceResult = measureBins(numBins, numFrames, options, reference);
+        const auto kernelResult = measureBins(numBins, numFrames, options, kernel);
+
+        double maxErrorDb = 0;
+        for( int i = 0; i < numBins; ++i )
+            maxErrorDb = juce::jmax(maxErrorDb, (double)std::abs(kernelData[(size_t)i] - referenceData[(size_t)i]));
+
+        for( auto variant : { "reference", "kernel" } )
+        {
+            const auto& result = juce::String(variant) == "kernel" ? kernelResult : referenceResult;
+            const auto error = juce::String(variant) == "kernel" ? maxErrorDb : 0.0;
+
+            //в общей схеме CSV: поля фильтров и колонки на сэмпл пустые, замер идет в колонки на бин
+            if( options.csv )
+            {
+                juce::StringArray fields { "decibels", "float" };
+                for( int i = 0; i < 10; ++i )
+                    fields.add({});
+                
+                fields.add(juce::String(result.allocations));
+                fields.add(variant);
+                fields.add(juce::String(fftSize));
+                fields.add(juce::String(result.nsPerSample, 4));
+                fields.add(juce::String(result.cyclesPerSample, 4));
+                fields.add(juce::String(error, 6));
+                
+                std::cout << fields.joinIntoString(",") << std::endl;
+                continue;
+            }
+
+            auto* object = new juce::DynamicObject();
+            object->setProperty("target", "decibels");
+            object->setProperty("variant", variant);
+            object->setProperty("fftSize", fftSize);
+            object->setProperty("nsPerBin", result.nsPerSample);
+            object->setProperty("cyclesPerBin", result.cyclesPerSample);
+            object->setProperty("allocations", (juce::int64)result.allocations);
+            object->setProperty("maxErrorDb", error);
+
+            std::cout << juce::JSON::toString(juce::var(object), true) << std::endl;
+        }
+    }
+}
+
+//==============================================================================
+//одна схема на все цели. фильтры меряются на сэмпл (nsPerSample, cyclesPerSample),
+//перевод в дБ - на бин спектра: у decibels свои колонки nsPerBin и cyclesPerBin,
+//а последние пять колонок заполняет только он
+static const char* csvHeader = "target,precision,sampleRate,blockSize,lowCutSlope,highCutSlope,"
+                               "lowCutBypassed,peakBypassed,highCutBypassed,channels,nsPerSample,cyclesPerSample,allocations,"
+                               "variant,fftSize,nsPerBin,cyclesPerBin,maxErrorDb";
+
+static juce::String formatResult(const BenchmarkCase& benchmarkCase, const BenchmarkResult& result, bool csv)
+{
+    const auto& settings = benchmarkCase.settings;
+    const auto precision = benchmarkCase.useDouble ? "double" : "float";
+    const auto lowCutSlope = 12 * (settings.lowCutSlope + 1);
+    const auto highCutSlope = 12 * (settings.highCutSlope + 1);
+
+    if( csv )
+    {
+        juce::StringArray fields;
+        fields.add(benchmarkCase.target);
+        fields.add(precision);
+        fields.add(juce::String(benchmarkCase.sampleRate, 0));
+        fields.add(juce::String(benchmarkCase.blockSize));
+        fields.add(juce::String(lowCutSlope));
+        fields.add(juce::String(highCutSlope));
+        fields.add(juce::String((int)settings.lowCutBypassed));
+        fields.add(juce::String((int)settings.peakBypassed));
+        fields.add(juce::String((int)settings.highCutBypassed));
+        fields.add(juce::String(numChannels));
+        fields.add(juce::String(result.nsPerSample, 4));
+        fields.add(juce::String(result.cyclesPerSample, 4));
+        fields.add(juce::String(result.allocations));
+        for( int i = 0; i < 5; ++i )
+            fields.add({});
+        
+        return fields.joinIntoString(",");
+    }
+
+    auto* object = new juce::DynamicObject();
+    object->setProperty("target", benchmarkCase.target);
+    object->setProperty("precision", precision);
+    object->setProperty("sampleRate", benchmarkCase.sampleRate);
+    object->setProperty("blockSize", benchmarkCase.blockSize);
+    object->setProperty("lowCutSlope", lowCutSlope);
+    object->setProperty("highCutSlope", highCutSlope);
+    object->setProperty("lowCutBypassed", settings.lowCutBypassed);
+    object->setProperty("peakBypassed", settings.peakBypassed);
+    object->setProperty("highCutBypassed", settings.highCutBypassed);
+    object->setProperty("channels", numChannels);
+    object->setProperty("nsPerSample", result.nsPerSample);
+    object->setProperty("cyclesPerSample", result.cyclesPerSample);
+    object->setProperty("allocations", (juce::int64)result.allocations);
+
+    return juce::JSON::toString(juce::var(object), true);
+}
+
+static BenchmarkOptions parseOptions(const juce::ArgumentList& args)
+{
+    BenchmarkOptions options;
+
+    auto getList = [&args](const juce::String& option)
+    {
+        return juce::StringArray::fromTokens(args.getValueForOption(option), ",", "");
+    };
+
+    if( args.containsOption("--quick") )
+    {
+        options.sampleRates = { 48000.0 };
+        options.blockSizes = { 64, 512, 4096 };
+        options.samplesPerRun = 1 << 14;
+        options.numRepeats = 3;
+    }
+
+    if( args.containsOption("--targets") )
+        options.targets = getList("--targets");
+
+    if( args.containsOption("--precision") )
+        options.precisions = getList("--precision");
+
+    if( args.containsOption("--rates") )
+    {
+        options.sampleRates.clear();
+        for( auto& rate : getList("--rates") )
+            options.sampleRates.add(rate.getDoubleValue());
+    }
+
+    if( args.containsOption("--blocks") )
+    {
+        options.blockSizes.clear();
+        for( auto& size : getList("--blocks") )
+            options.blockSizes.add(juce::jmax(1, size.getIntValue()));
+    }
+
+    if( args.containsOption("--samples") )
+        options.samplesPerRun = juce::jmax(1, args.getValueForOption("--samples").getIntValue());
+
+    if( args.containsOption("--repeats") )
+        options.numRepeats = juce::jmax(1, args.getValueForOption("--repeats").getIntValue());
+
+    options.csv = args.getValueForOption("--format") == "csv";
+
+    return options;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    isMeasuringThread = true;
+    
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const auto options = parseOptions(juce::ArgumentList(argc, argv));
+
+    SimpleEQAudioProcessor processor;
+
+    //типичная настройка: все полосы заметно работают
+    ChainSettings baseSettings;
+    baseSettings.lowCutFreq = 80.f;
+    baseSettings.highCutFreq = 12000.f;
+    baseSettings.peakFreq = 1000.f;
+    baseSettings.peakGainInDecibels = 6.f;
+    baseSettings.peakQuality = 1.f;
+
+    if( options.csv )
+        std::cout << csvHeader << std::endl;
+
+    for( auto& target : options.targets )
+    {
+        if( target == "decibels" )
+        {
+            runDecibels(options);
+            continue;
+        }
+
+        for( auto& precision : options.precisions )
+        {
+            for( auto sampleRate : options.sampleRates )
+            {
+                for( auto blockSize : options.blockSizes )
+                {
+                    for( int lowCutSlope = Slope_12; lowCutSlope <= Slope_48; ++lowCutSlope )
+                    {
+                        for( int highCutSlope = Slope_12; highCutSlope <= Slope_48; ++highCutSlope )
+                        {
+                            //биты маски: LowCut, Peak, HighCut
+                            for( int bypassMask = 0; bypassMask < 8; ++bypassMask )
+                            {
+                                BenchmarkCase benchmarkCase;
+                                benchmarkCase.target = target;
+                                benchmarkCase.useDouble = precision == "double";
+                                benchmarkCase.sampleRate = sampleRate;
+                                benchmarkCase.blockSize = blockSize;
+                                benchmarkCase.settings = baseSettings;
+                                benchmarkCase.settings.lowCutSlope = static_cast<Slope>(lowCutSlope);
+                                benchmarkCase.settings.highCutSlope = static_cast<Slope>(highCutSlope);
+                                benchmarkCase.settings.lowCutBypassed = (bypassMask & 1) != 0;
+                                benchmarkCase.settings.peakBypassed = (bypassMask & 2) != 0;
+                                benchmarkCase.settings.highCutBypassed = (bypassMask & 4) != 0;
+
+                                const auto result = benchmarkCase.useDouble ? run<double>(processor, benchmarkCase, options)
+                                                                            : run<float>(processor, benchmarkCase, options);
+
+                                std::cout << formatResult(benchmarkCase, result, options.csv) << std::endl;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}